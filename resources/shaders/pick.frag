@@ -0,0 +1,10 @@
+#version 330 core
+// what was hit: 0 nothing, 1 terrain, 2 + i terrain object i
+uniform uint pickId;
+
+out uint fragId;
+
+void main()
+{
+    fragId = pickId;
+}
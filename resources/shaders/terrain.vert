@@ -1,7 +1,6 @@
 #version 330 core
-layout(location = 0) in vec3 vertex;
-layout(location = 1) in vec3 normal;
-layout(location = 2) in vec3 inColor;
+// CDLOD patch instance: origin (row, col) in grid vertices, grid stride, LOD level
+layout(location = 0) in vec4 patchInstance;
 out vec4 vert;
 out vec4 norm;
 out vec3 color;
@@ -10,11 +9,42 @@ out vec3 lightDir;
 uniform mat4 projMatrix;
 uniform mat4 mvMatrix;
 
+// LOD patches are (patchResolution + 1)^2 grid vertices, addressed by gl_VertexID
+uniform int patchResolution;
+uniform vec3 cameraPosition;        // terrain space
+uniform vec2 morphRanges[16];       // per level: distances where the morph to the next level starts/ends
+
+// gridResolution, heightMap, the color ramp and its helpers come from terrain_common.glsl
+
 void main()
 {
+    float res = float(gridResolution);
+    float stride = patchInstance.z;
+    int level = int(patchInstance.w);
+
+    // grid position of this patch vertex, in full-resolution grid vertices
+    ivec2 local = ivec2(gl_VertexID / (patchResolution + 1), gl_VertexID % (patchResolution + 1));
+    vec2 gridPos = patchInstance.xy + vec2(local) * stride;
+
+    // patches overhanging the last row/column are clamped onto it
+    gridPos = min(gridPos, vec2(res));
+
+    // morph factor from the distance to the unmorphed vertex
+    float dist = distance(vec3(gridPos / res, sampleHeight(gridPos)), cameraPosition);
+    vec2 range = morphRanges[level];
+    float morph = clamp((dist - range.x) / (range.y - range.x), 0.0, 1.0);
+
+    // vertices that are odd at this level slide onto the next coarser grid;
+    // the last row/column is on every level's grid, so it stays put
+    vec2 odd = mod(gridPos / stride, 2.0) * step(gridPos, vec2(res - 0.5));
+    gridPos -= odd * stride * morph;
+
+    vec3 normal = sampleNormal(gridPos);
+    vec3 vertex = vec3(gridPos / res, sampleHeight(gridPos));
+
     vert  = mvMatrix * vec4(vertex, 1.0);
     norm  = transpose(inverse(mvMatrix)) *  vec4(normal, 0.0);
-    color = inColor;
+    color = getColor(normal, vertex);
     lightDir = normalize(vec3(mvMatrix * vec4(1, 0, 1, 0)));
     gl_Position = projMatrix * mvMatrix * vec4(vertex, 1.0);
 }
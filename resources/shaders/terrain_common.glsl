@@ -0,0 +1,46 @@
+// Shared by the terrain stages; spliced in after each stage's #version line by
+// ShaderLoader::readShaderSource, so every path samples and shades the same way
+
+uniform int gridResolution;
+
+// R32F heights of the (res + 3)^2 sample grid, one-sample apron included;
+// grid sample (row, col) is texel (col + 1, row + 1)
+uniform sampler2D heightMap;
+
+// height/slope color ramp
+uniform vec3 sandColor;
+uniform float colorHeightMin;
+uniform float colorHeightMax;
+
+float interpolate(float A, float B, float alpha)
+{
+    float ease = (3.0 * alpha * alpha) - (2.0 * alpha * alpha * alpha);
+    return A + ease * (B - A);
+}
+
+// Sand brightens towards white with height and on steep slopes
+vec3 getColor(vec3 normal, vec3 position)
+{
+    float a = clamp((position.z - colorHeightMin) / (colorHeightMax - colorHeightMin), 0.0, 1.0);
+    float ease = (3.0 * a * a) - (2.0 * a * a * a);
+    vec3 c = vec3(interpolate(sandColor.r, ease, ease), interpolate(sandColor.g, ease, ease),
+                  interpolate(sandColor.b, ease, ease));
+
+    a = dot(normal, vec3(0, 0, 1));
+    ease = (3.0 * a * a) - (2.0 * a * a * a);
+    return vec3(interpolate(1.0, c.r, ease), interpolate(1.0, c.g, ease), interpolate(1.0, c.b, ease));
+}
+
+// Height at a (possibly fractional) grid position; linear filtering interpolates between samples
+float sampleHeight(vec2 gridPos)
+{
+    return texture(heightMap, (gridPos.yx + 1.5) / float(gridResolution + 3)).r;
+}
+
+// Central differences over one grid step
+vec3 sampleNormal(vec2 gridPos)
+{
+    float dzdx = (sampleHeight(gridPos + vec2(1, 0)) - sampleHeight(gridPos - vec2(1, 0))) * float(gridResolution) / 2.0;
+    float dzdy = (sampleHeight(gridPos + vec2(0, 1)) - sampleHeight(gridPos - vec2(0, 1))) * float(gridResolution) / 2.0;
+    return normalize(vec3(-dzdx, -dzdy, 1.0));
+}
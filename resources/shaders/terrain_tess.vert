@@ -0,0 +1,9 @@
+#version 410 core
+// patch corner, in grid vertices (row, col)
+layout(location = 0) in vec2 gridCorner;
+out vec2 tcGridPos;
+
+void main()
+{
+    tcGridPos = gridCorner;
+}
@@ -0,0 +1,136 @@
+#include "gardenfile.h"
+
+#include <QSaveFile>
+#include <cstring>
+#include <iostream>
+
+static uint64_t alignOffset(uint64_t offset) {
+    return (offset + kGardenAlignment - 1) & ~(kGardenAlignment - 1);
+}
+
+GardenFile::GardenFile()
+{
+}
+
+GardenFile::~GardenFile()
+{
+    close();
+}
+
+bool GardenFile::save(const std::string& path, Terrain& terrain,
+                      const std::vector<GardenObject>& objects) {
+    std::vector<float> baseHeights;
+    std::vector<float> heightDeltas;
+    terrain.readHeightLayers(baseHeights, heightDeltas);
+
+    const NoiseParams& noise = terrain.getNoiseParams();
+
+    GardenFileHeader header = {};
+    std::memcpy(header.magic, "ZGDN", 4);
+    header.version = kGardenVersion;
+    header.resolution = terrain.getResolution();
+    header.seed = terrain.getSeed();
+    header.octaves = noise.octaves;
+    header.frequency = noise.frequency;
+    header.amplitude = noise.amplitude;
+    header.lacunarity = noise.lacunarity;
+    header.gain = noise.gain;
+    header.variant = (int32_t)noise.variant;
+    header.gridSampleCount = baseHeights.size();
+    header.objectCount = objects.size();
+
+    header.baseHeightsOffset = alignOffset(sizeof(GardenFileHeader));
+    header.heightDeltasOffset = alignOffset(header.baseHeightsOffset + baseHeights.size() * sizeof(float));
+    header.objectsOffset = alignOffset(header.heightDeltasOffset + heightDeltas.size() * sizeof(float));
+
+    // QSaveFile only replaces the old garden once everything has been written
+    QSaveFile file(QString::fromStdString(path));
+    if (!file.open(QIODevice::WriteOnly)) {
+        std::cerr << "Could not open garden file for writing: " << path << std::endl;
+        return false;
+    }
+
+    auto writeSection = [&](uint64_t offset, const void* data, size_t bytes) {
+        static const char padding[kGardenAlignment] = {};
+        file.write(padding, offset - file.pos());
+        file.write(static_cast<const char*>(data), bytes);
+    };
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeSection(header.baseHeightsOffset, baseHeights.data(), baseHeights.size() * sizeof(float));
+    writeSection(header.heightDeltasOffset, heightDeltas.data(), heightDeltas.size() * sizeof(float));
+    writeSection(header.objectsOffset, objects.data(), objects.size() * sizeof(GardenObject));
+
+    if (!file.commit()) {
+        std::cerr << "Failed to write garden file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool GardenFile::open(const std::string& path) {
+    close();
+
+    m_file.setFileName(QString::fromStdString(path));
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        std::cerr << "Could not open garden file: " << path << std::endl;
+        return false;
+    }
+
+    uint64_t size = m_file.size();
+    if (size < sizeof(GardenFileHeader)) {
+        std::cerr << "Garden file is truncated: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    m_data = m_file.map(0, size);
+    if (!m_data) {
+        std::cerr << "Could not map garden file: " << path << std::endl;
+        close();
+        return false;
+    }
+    m_header = reinterpret_cast<const GardenFileHeader*>(m_data);
+
+    if (std::memcmp(m_header->magic, "ZGDN", 4) != 0 || m_header->version != kGardenVersion) {
+        std::cerr << "Not a garden file, or an unsupported version: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    // every section has to lie inside the mapping before anyone reads through it
+    auto sectionFits = [&](uint64_t offset, uint64_t count, uint64_t stride) {
+        return offset % kGardenAlignment == 0 && offset <= size && count <= (size - offset) / stride;
+    };
+    uint64_t side = (uint64_t)m_header->resolution + 3;
+    if (m_header->gridSampleCount != side * side ||
+        !sectionFits(m_header->baseHeightsOffset, m_header->gridSampleCount, sizeof(float)) ||
+        !sectionFits(m_header->heightDeltasOffset, m_header->gridSampleCount, sizeof(float)) ||
+        !sectionFits(m_header->objectsOffset, m_header->objectCount, sizeof(GardenObject))) {
+        std::cerr << "Garden file is corrupt: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void GardenFile::close() {
+    if (m_data) {
+        m_file.unmap(m_data);
+        m_data = nullptr;
+    }
+    m_header = nullptr;
+    if (m_file.isOpen()) m_file.close();
+}
+
+NoiseParams GardenFile::noiseParams() {
+    NoiseParams noise;
+    noise.octaves = m_header->octaves;
+    noise.frequency = m_header->frequency;
+    noise.amplitude = m_header->amplitude;
+    noise.lacunarity = m_header->lacunarity;
+    noise.gain = m_header->gain;
+    noise.variant = (NoiseVariant)m_header->variant;
+    return noise;
+}
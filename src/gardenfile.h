@@ -0,0 +1,81 @@
+#ifndef GARDENFILE_H
+#define GARDENFILE_H
+
+#include <QFile>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "terrain.h"
+
+// Binary garden file. Every section is stored exactly as it sits in memory, so
+// loading maps the file and hands out pointers into it without any parsing.
+// Multi-byte values use the native (little-endian) byte order.
+//
+//   GardenFileHeader
+//   float         baseHeights[gridSampleCount]
+//   float         heightDeltas[gridSampleCount]
+//   GardenObject  objects[objectCount]
+//
+// Sections start at the offsets stored in the header, aligned to kGardenAlignment.
+
+static constexpr uint32_t kGardenVersion = 2;
+static constexpr uint64_t kGardenAlignment = 16;
+
+struct GardenFileHeader {
+    char magic[4];              // "ZGDN"
+    uint32_t version;
+    uint32_t resolution;        // vertices per side minus one
+    uint32_t seed;
+
+    // NoiseParams, flattened so the layout does not depend on the struct
+    int32_t octaves;
+    float frequency;
+    float amplitude;
+    float lacunarity;
+    float gain;
+    int32_t variant;
+
+    uint32_t gridSampleCount;   // (resolution + 3)^2, heights including the apron
+    uint32_t objectCount;
+
+    uint64_t baseHeightsOffset;
+    uint64_t heightDeltasOffset;
+    uint64_t objectsOffset;
+};
+
+struct GardenObject {
+    int32_t type;               // PrimitiveType
+    float terrainPosition[2];
+    float size;
+    float color[4];
+    float modelMatrix[16];      // column major, like glm
+};
+
+class GardenFile
+{
+public:
+    GardenFile();
+    ~GardenFile();
+
+    // Writes the terrain's height layers and noise settings, and the object list
+    static bool save(const std::string& path, Terrain& terrain,
+                     const std::vector<GardenObject>& objects);
+
+    // Maps the file and validates the header; the pointers below stay valid
+    // until close() or destruction
+    bool open(const std::string& path);
+    void close();
+
+    const GardenFileHeader& header() { return *m_header; }
+    NoiseParams noiseParams();
+    const float* baseHeights() { return reinterpret_cast<const float*>(m_data + m_header->baseHeightsOffset); }
+    const float* heightDeltas() { return reinterpret_cast<const float*>(m_data + m_header->heightDeltasOffset); }
+    const GardenObject* objects() { return reinterpret_cast<const GardenObject*>(m_data + m_header->objectsOffset); }
+
+private:
+    QFile m_file;
+    uchar* m_data = nullptr;
+    const GardenFileHeader* m_header = nullptr;
+};
+
+#endif // GARDENFILE_H
@@ -0,0 +1,136 @@
+#include "gpupicker.h"
+
+#include <cstring>
+#include <iostream>
+#include "glm/gtc/matrix_transform.hpp"
+
+GpuPicker::GpuPicker()
+{
+}
+
+void GpuPicker::initialize() {
+    glGenTextures(1, &m_idTexture);
+    glBindTexture(GL_TEXTURE_2D, m_idTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, 1, 1, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenTextures(1, &m_depthTexture);
+    glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, 1, 1, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &m_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_idTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_depthTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Pick framebuffer is not complete" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    for (Readback& readback : m_readbacks) {
+        glGenBuffers(1, &readback.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(uint32_t) + sizeof(float), nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void GpuPicker::destroy() {
+    for (Readback& readback : m_readbacks) {
+        if (readback.fence) glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+        glDeleteBuffers(1, &readback.pbo);
+    }
+    glDeleteFramebuffers(1, &m_fbo);
+    glDeleteTextures(1, &m_idTexture);
+    glDeleteTextures(1, &m_depthTexture);
+}
+
+bool GpuPicker::beginPass(int x, int y, int width, int height, glm::mat4& pickMatrix) {
+    // a slot whose readback is still in flight can't be reused without waiting
+    Readback& readback = m_readbacks[m_nextReadback];
+    if (readback.fence) return false;
+
+    m_current = &readback;
+    m_current->x = x;
+    m_current->y = y;
+    m_current->width = width;
+    m_current->height = height;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glViewport(0, 0, 1, 1);
+    GLuint clearId[4] = {kNoId, 0, 0, 0};
+    glClearBufferuiv(GL_COLOR, 0, clearId);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    // scales NDC so the pixel's footprint, centered on (cx, cy), fills the whole target
+    float cx = 2.0f * (x + 0.5f) / width - 1.0f;
+    float cy = 2.0f * (y + 0.5f) / height - 1.0f;
+    pickMatrix = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(-cx * width, -cy * height, 0.0f)),
+                            glm::vec3(width, height, 1.0f));
+    return true;
+}
+
+void GpuPicker::endPass(const glm::mat4& viewProj, uint64_t tag) {
+    m_current->viewProj = viewProj;
+    m_current->tag = tag;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, m_current->pbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(0, 0, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, reinterpret_cast<void *>(0));
+    glReadPixels(0, 0, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, reinterpret_cast<void *>(sizeof(uint32_t)));
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    m_current->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_current = nullptr;
+    m_nextReadback = 1 - m_nextReadback;
+}
+
+bool GpuPicker::isPending() {
+    return m_readbacks[0].fence || m_readbacks[1].fence;
+}
+
+bool GpuPicker::poll(GpuPickResult& result) {
+    bool found = false;
+
+    // oldest first, so the newest pick that landed wins
+    for (int i = 0; i < 2; i++) {
+        Readback& readback = m_readbacks[(m_nextReadback + i) % 2];
+        if (!readback.fence) continue;
+
+        GLenum status = glClientWaitSync(readback.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) continue;
+        glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+
+        uint32_t id;
+        float depth;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+        const char* data = static_cast<const char*>(
+            glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(uint32_t) + sizeof(float), GL_MAP_READ_BIT));
+        if (!data) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            continue;
+        }
+        std::memcpy(&id, data, sizeof(uint32_t));
+        std::memcpy(&depth, data + sizeof(uint32_t), sizeof(float));
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        result.id = id;
+        result.pixel = glm::ivec2(readback.x, readback.y);
+        result.tag = readback.tag;
+        if (id != kNoId) {
+            glm::vec4 ndc(2.0f * (readback.x + 0.5f) / readback.width - 1.0f,
+                          2.0f * (readback.y + 0.5f) / readback.height - 1.0f,
+                          2.0f * depth - 1.0f, 1.0f);
+            glm::vec4 world = glm::inverse(readback.viewProj) * ndc;
+            result.worldPos = glm::vec3(world) / world.w;
+        }
+        found = true;
+    }
+    return found;
+}
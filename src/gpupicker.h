@@ -0,0 +1,65 @@
+#ifndef GPUPICKER_H
+#define GPUPICKER_H
+
+#include <GL/glew.h>
+#include <cstdint>
+#include "glm/glm.hpp"
+
+struct GpuPickResult {
+    uint32_t id;            // GpuPicker::kNoId, kTerrainId, or kFirstObjectId + object index
+    glm::vec3 worldPos;     // reconstructed from depth; unset for kNoId
+    glm::ivec2 pixel;       // the pixel passed to beginPass()
+    uint64_t tag;           // the tag passed to endPass()
+};
+
+// Picks whatever is under one pixel by rendering IDs and depth into a 1x1
+// R32UI/depth target. The projection is zoomed onto that pixel, so the pass costs
+// next to nothing in fill. The pixel is copied into a pixel buffer object and read
+// a frame or more later, once its fence has signaled, so the CPU never waits on
+// the GPU. When both buffers are still in flight, no pass can start that frame.
+class GpuPicker
+{
+public:
+    static constexpr uint32_t kNoId = 0;
+    static constexpr uint32_t kTerrainId = 1;
+    static constexpr uint32_t kFirstObjectId = 2;
+
+    GpuPicker();
+
+    // Both need the GL context current
+    void initialize();
+    void destroy();
+
+    // Binds and clears the pick target for pixel (x, y) of a width x height viewport
+    // (device pixels, origin bottom-left), and sets pickMatrix to the matrix to put in
+    // front of the projection while drawing IDs. Returns false, binding nothing, when
+    // no readback slot is free; skip the pass and try again on a later frame.
+    bool beginPass(int x, int y, int width, int height, glm::mat4& pickMatrix);
+    // Queues the readback of the pass. viewProj is the un-zoomed projection * view
+    // the pass was drawn with, used to turn the depth back into a position; tag is
+    // handed back with the result, so callers can tell whether it is still current.
+    void endPass(const glm::mat4& viewProj, uint64_t tag);
+
+    // Collects readbacks that have landed; true when result holds a new pick
+    bool poll(GpuPickResult& result);
+    bool isPending();
+
+private:
+    struct Readback {
+        GLuint pbo = 0;             // id (uint32) then depth (float)
+        GLsync fence = nullptr;
+        int x, y, width, height;
+        glm::mat4 viewProj;
+        uint64_t tag;
+    };
+
+    GLuint m_fbo = 0;
+    GLuint m_idTexture = 0;
+    GLuint m_depthTexture = 0;
+
+    Readback m_readbacks[2];
+    int m_nextReadback = 0;
+    Readback* m_current = nullptr;  // the slot the open pass reads back into
+};
+
+#endif // GPUPICKER_H
@@ -0,0 +1,180 @@
+#include "heightpyramid.h"
+
+#include <algorithm>
+#include <cmath>
+#include "utils/raytriangle.h"
+
+HeightPyramid::HeightPyramid()
+{
+}
+
+float HeightPyramid::cellMax(const std::vector<float>& heights, int row, int col) const {
+    return std::max(std::max(heights[gridIndex(row, col)], heights[gridIndex(row + 1, col)]),
+                    std::max(heights[gridIndex(row, col + 1)], heights[gridIndex(row + 1, col + 1)]));
+}
+
+void HeightPyramid::refreshNode(int level, int row, int col) {
+    const Level& below = m_levels[level - 1];
+    float m = -INFINITY;
+    for (int r = row * 2; r < std::min(row * 2 + 2, below.rows); r++) {
+        for (int c = col * 2; c < std::min(col * 2 + 2, below.cols); c++) {
+            m = std::max(m, below.maxHeights[r * below.cols + c]);
+        }
+    }
+    m_levels[level].maxHeights[row * m_levels[level].cols + col] = m;
+}
+
+void HeightPyramid::build(const std::vector<float>& heights, int resolution) {
+    m_resolution = resolution;
+    m_levels.clear();
+
+    Level cells = {resolution, resolution, std::vector<float>(resolution * resolution)};
+    for (int row = 0; row < resolution; row++) {
+        for (int col = 0; col < resolution; col++) {
+            cells.maxHeights[row * resolution + col] = cellMax(heights, row, col);
+        }
+    }
+    m_levels.push_back(std::move(cells));
+
+    while (m_levels.back().rows > 1 || m_levels.back().cols > 1) {
+        int rows = (m_levels.back().rows + 1) / 2;
+        int cols = (m_levels.back().cols + 1) / 2;
+        m_levels.push_back({rows, cols, std::vector<float>(rows * cols)});
+
+        int level = m_levels.size() - 1;
+        for (int row = 0; row < rows; row++) {
+            for (int col = 0; col < cols; col++) {
+                refreshNode(level, row, col);
+            }
+        }
+    }
+}
+
+void HeightPyramid::updateRect(const std::vector<float>& heights, int startRow, int endRow, int startCol, int endCol) {
+    // cell (r, c) has corners (r..r+1, c..c+1)
+    int minRow = std::max(0, startRow - 1);
+    int maxRow = std::min(m_resolution - 1, endRow - 1);
+    int minCol = std::max(0, startCol - 1);
+    int maxCol = std::min(m_resolution - 1, endCol - 1);
+    if (minRow > maxRow || minCol > maxCol) return;
+
+    for (int row = minRow; row <= maxRow; row++) {
+        for (int col = minCol; col <= maxCol; col++) {
+            m_levels[0].maxHeights[row * m_resolution + col] = cellMax(heights, row, col);
+        }
+    }
+
+    for (int level = 1; level < (int)m_levels.size(); level++) {
+        minRow /= 2;
+        maxRow /= 2;
+        minCol /= 2;
+        maxCol /= 2;
+        for (int row = minRow; row <= maxRow; row++) {
+            for (int col = minCol; col <= maxCol; col++) {
+                refreshNode(level, row, col);
+            }
+        }
+    }
+}
+
+// Narrows [t0, t1] to where the ray is inside the xy rectangle; false if it never is
+static bool clipToRect(const glm::vec3& origin, const glm::vec3& dir, glm::vec2 rectMin, glm::vec2 rectMax,
+                       float& t0, float& t1) {
+    for (int axis = 0; axis < 2; axis++) {
+        if (std::abs(dir[axis]) < 1e-12f) {
+            if (origin[axis] < rectMin[axis] || origin[axis] > rectMax[axis]) return false;
+            continue;
+        }
+        float tA = (rectMin[axis] - origin[axis]) / dir[axis];
+        float tB = (rectMax[axis] - origin[axis]) / dir[axis];
+        if (tA > tB) std::swap(tA, tB);
+        t0 = std::max(t0, tA);
+        t1 = std::min(t1, tB);
+    }
+    return t0 <= t1;
+}
+
+// The two triangles of each cell in the block of up to 2x2 cells at (row, col),
+// split like the rendered mesh, tested as one packet
+bool HeightPyramid::intersectCells(const std::vector<float>& heights, int row, int col, int size,
+                                   const glm::vec3& origin, const glm::vec3& dir, float& t) const {
+    auto position = [&](int r, int c) {
+        return glm::vec3(1.0f * r / m_resolution, 1.0f * c / m_resolution, heights[gridIndex(r, c)]);
+    };
+
+    static_assert(kTrianglePacketWidth >= 8, "a 2x2 block of cells has eight triangles");
+    TrianglePacket packet;
+    packet.clear();
+    int lane = 0;
+    for (int r = row; r < std::min(row + size, m_resolution); r++) {
+        for (int c = col; c < std::min(col + size, m_resolution); c++) {
+            glm::vec3 v1 = position(r, c);
+            glm::vec3 v2 = position(r + 1, c);
+            glm::vec3 v3 = position(r + 1, c + 1);
+            glm::vec3 v4 = position(r, c + 1);
+            packet.set(lane++, v1, v2, v3);
+            packet.set(lane++, v1, v3, v4);
+        }
+    }
+
+    t = INFINITY;
+    return rayIntersectsPacket(origin, dir, packet, t) != -1;
+}
+
+bool HeightPyramid::intersectNode(const std::vector<float>& heights, int level, int row, int col,
+                                  const glm::vec3& origin, const glm::vec3& dir, float t0, float t1, float& t) const {
+    // z is linear along the ray, so its lowest point over [t0, t1] is at one end
+    float lowestZ = origin.z + dir.z * (dir.z < 0 ? t1 : t0);
+    if (lowestZ > m_levels[level].maxHeights[row * m_levels[level].cols + col]) return false;
+
+    // a level 1 node's 2x2 cells fill one triangle packet; they don't overlap in xy,
+    // so the packet's nearest hit is the node's nearest hit
+    if (level <= 1) return intersectCells(heights, row << level, col << level, 1 << level, origin, dir, t);
+
+    // children in the order the ray enters them; they don't overlap in xy, so the
+    // first one with a hit holds the nearest hit
+    struct Child {
+        float t0;
+        float t1;
+        int row;
+        int col;
+    };
+    Child children[4];
+    int count = 0;
+
+    const Level& below = m_levels[level - 1];
+    float childSize = (float)(1 << (level - 1)) / m_resolution;
+    for (int r = row * 2; r < std::min(row * 2 + 2, below.rows); r++) {
+        for (int c = col * 2; c < std::min(col * 2 + 2, below.cols); c++) {
+            // padded slightly so rays grazing a shared edge aren't lost between cells
+            glm::vec2 rectMin = glm::vec2(r, c) * childSize - 1e-6f;
+            glm::vec2 rectMax = glm::min(glm::vec2(r + 1, c + 1) * childSize, glm::vec2(1.0f)) + 1e-6f;
+            float ct0 = t0;
+            float ct1 = t1;
+            if (clipToRect(origin, dir, rectMin, rectMax, ct0, ct1)) {
+                children[count++] = {ct0, ct1, r, c};
+            }
+        }
+    }
+    std::sort(children, children + count, [](const Child& a, const Child& b) { return a.t0 < b.t0; });
+
+    for (int i = 0; i < count; i++) {
+        if (intersectNode(heights, level - 1, children[i].row, children[i].col,
+                          origin, dir, children[i].t0, children[i].t1, t)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HeightPyramid::intersect(const std::vector<float>& heights, const glm::vec3& origin, const glm::vec3& dir,
+                              float& t) const {
+    if (m_levels.empty()) return false;
+
+    float t0 = 0.0f;
+    float t1 = INFINITY;
+    if (!clipToRect(origin, dir, glm::vec2(0.0f), glm::vec2(1.0f), t0, t1)) return false;
+
+    int top = m_levels.size() - 1;
+    return intersectNode(heights, top, 0, 0, origin, dir, t0, t1, t);
+}
@@ -0,0 +1,53 @@
+#ifndef HEIGHTPYRAMID_H
+#define HEIGHTPYRAMID_H
+
+#include <vector>
+#include "glm/glm.hpp"
+
+// Max-height mip pyramid over the terrain's grid cells, for ray picking.
+//
+// Level 0 holds the highest corner of every cell; each level above holds the max
+// of a 2x2 block of the level below, rounded up at odd sizes. A ray descends only
+// into nodes whose max it actually dips under, visiting children in the order it
+// crosses them, so only the few cells near the hit get their triangles tested,
+// a 2x2 block at a time.
+//
+// Heights are read from a grid-layout array like Terrain's: (res + 3)^2 samples,
+// with a one-sample apron around the (res + 1)^2 vertices.
+class HeightPyramid
+{
+public:
+    HeightPyramid();
+
+    void build(const std::vector<float>& heights, int resolution);
+    // Refreshes the cells that touch grid samples [startRow, endRow) x [startCol, endCol)
+    // and the nodes above them
+    void updateRect(const std::vector<float>& heights, int startRow, int endRow, int startCol, int endCol);
+
+    int getResolution() const { return m_resolution; }
+
+    // Nearest hit of the ray origin + t * dir (terrain space, t > 0) with the terrain's
+    // triangles. heights must be the array the pyramid was built from.
+    bool intersect(const std::vector<float>& heights, const glm::vec3& origin, const glm::vec3& dir, float& t) const;
+
+private:
+    struct Level {
+        int rows;
+        int cols;
+        std::vector<float> maxHeights;
+    };
+
+    int gridIndex(int row, int col) const { return (row + 1) * (m_resolution + 3) + (col + 1); }
+    float cellMax(const std::vector<float>& heights, int row, int col) const;
+    void refreshNode(int level, int row, int col);
+
+    bool intersectNode(const std::vector<float>& heights, int level, int row, int col,
+                       const glm::vec3& origin, const glm::vec3& dir, float t0, float t1, float& t) const;
+    bool intersectCells(const std::vector<float>& heights, int row, int col, int size,
+                        const glm::vec3& origin, const glm::vec3& dir, float& t) const;
+
+    int m_resolution = 0;
+    std::vector<Level> m_levels;  // m_levels[0] is one node per grid cell
+};
+
+#endif // HEIGHTPYRAMID_H
@@ -95,6 +95,13 @@ void MainWindow::initialize() {
     buttonLayout->addWidget(rakeMode);
     buttonLayout->addWidget(camMode);
 
+    saveGarden = makeTextButton("Save");
+    loadGarden = makeTextButton("Load");
+    saveGarden->setCheckable(false);
+    loadGarden->setCheckable(false);
+    buttonLayout->addWidget(saveGarden);
+    buttonLayout->addWidget(loadGarden);
+
     vLayout->addStretch();
     vLayout->addLayout(buttonLayout);
     vLayout->addStretch();
@@ -117,6 +124,7 @@ void MainWindow::connectUIElements() {
     connectRockMode();
     connectRakeMode();
     connectCamMode();
+    connectGardenFiles();
 }
 
 void MainWindow::connectTreeMode() {
@@ -182,3 +190,22 @@ void MainWindow::onCamMode() {
     settings.camMode = true;
     realtime->settingsChanged();
 }
+
+void MainWindow::connectGardenFiles() {
+    connect(saveGarden, &QPushButton::clicked, this, &MainWindow::onSaveGarden);
+    connect(loadGarden, &QPushButton::clicked, this, &MainWindow::onLoadGarden);
+}
+void MainWindow::onSaveGarden() {
+    QString filePath = QFileDialog::getSaveFileName(this, tr("Save Garden"), QDir::currentPath(),
+                                                    tr("Garden Files (*.garden)"));
+    if (!filePath.isNull()) {
+        realtime->saveGarden(filePath.toStdString());
+    }
+}
+void MainWindow::onLoadGarden() {
+    QString filePath = QFileDialog::getOpenFileName(this, tr("Load Garden"), QDir::currentPath(),
+                                                    tr("Garden Files (*.garden)"));
+    if (!filePath.isNull()) {
+        realtime->loadGarden(filePath.toStdString());
+    }
+}
@@ -24,6 +24,7 @@ private:
     void connectRockMode();
     void connectRakeMode();
     void connectCamMode();
+    void connectGardenFiles();
 
 
 
@@ -34,6 +35,8 @@ private:
     QPushButton *rockMode;
     QPushButton *rakeMode;
     QPushButton *camMode;
+    QPushButton *saveGarden;
+    QPushButton *loadGarden;
 
 
 
@@ -43,5 +46,7 @@ private slots:
     void onRockMode();
     void onRakeMode();
     void onCamMode();
+    void onSaveGarden();
+    void onLoadGarden();
 
 };
@@ -1,6 +1,7 @@
 #ifndef MOUSE_H
 #define MOUSE_H
 #include "glm/glm.hpp"
+#include "heightpyramid.h"
 #include <GL/glew.h>
 #include <iostream>
 #include <optional>
@@ -14,7 +15,13 @@ public:
     static std::optional<glm::vec3> mouse_click_callback(int b, int s, int mouse_x, int mouse_y,
                                                          float width, float height,
                                                          glm::mat4 proj, glm::mat4 view,
-                                                         const std::vector<float>& terrainVerts,
-                                                         int resolution, const glm::mat4& worldMatrix);};
+                                                         const std::vector<float>& terrainHeights,
+                                                         const HeightPyramid& heightPyramid,
+                                                         const glm::mat4& worldMatrix);
+    // The ray through a window pixel, in terrain space (inverse worldMatrix)
+    static void terrainRay(int mouse_x, int mouse_y, float width, float height,
+                           const glm::mat4& proj, const glm::mat4& view, const glm::mat4& worldMatrix,
+                           glm::vec3& origin, glm::vec3& dir);
+};
 
 #endif // MOUSE_H
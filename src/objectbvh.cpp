@@ -0,0 +1,266 @@
+#include "objectbvh.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+float surfaceArea(const glm::vec3& boxMin, const glm::vec3& boxMax) {
+    glm::vec3 d = boxMax - boxMin;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+float unionArea(const glm::vec3& minA, const glm::vec3& maxA, const glm::vec3& minB, const glm::vec3& maxB) {
+    return surfaceArea(glm::min(minA, minB), glm::max(maxA, maxB));
+}
+
+// Entry distance of the ray into the box, or INFINITY if it misses within [0, tMax]
+float rayBoxEntry(const glm::vec3& origin, const glm::vec3& invDir, const glm::vec3& boxMin,
+                  const glm::vec3& boxMax, float tMax) {
+    float t0 = 0.0f;
+    float t1 = tMax;
+    for (int axis = 0; axis < 3; axis++) {
+        // parallel to the slab: inside it everywhere or nowhere. The slab distances would
+        // be 0 * inf = NaN for an origin on one of its planes.
+        if (std::isinf(invDir[axis])) {
+            if (origin[axis] < boxMin[axis] || origin[axis] > boxMax[axis]) return INFINITY;
+            continue;
+        }
+        float tA = (boxMin[axis] - origin[axis]) * invDir[axis];
+        float tB = (boxMax[axis] - origin[axis]) * invDir[axis];
+        if (tA > tB) std::swap(tA, tB);
+        t0 = std::max(t0, tA);
+        t1 = std::min(t1, tB);
+    }
+    return t0 <= t1 ? t0 : INFINITY;
+}
+
+}
+
+ObjectBvh::ObjectBvh()
+{
+}
+
+int ObjectBvh::allocateNode() {
+    if (m_freeList == -1) {
+        m_nodes.push_back({});
+        m_freeList = m_nodes.size() - 1;
+        m_nodes[m_freeList].parent = -1;
+    }
+    int node = m_freeList;
+    m_freeList = m_nodes[node].parent;
+    m_nodes[node] = {glm::vec3(0.0f), glm::vec3(0.0f), -1, -1, -1, -1, 0};
+    return node;
+}
+
+void ObjectBvh::freeNode(int node) {
+    m_nodes[node].parent = m_freeList;
+    m_nodes[node].height = -1;
+    m_freeList = node;
+}
+
+int ObjectBvh::insert(const glm::vec3& boxMin, const glm::vec3& boxMax, int object) {
+    int leaf = allocateNode();
+    m_nodes[leaf].boxMin = boxMin;
+    m_nodes[leaf].boxMax = boxMax;
+    m_nodes[leaf].object = object;
+    insertLeaf(leaf);
+    return leaf;
+}
+
+void ObjectBvh::remove(int leaf) {
+    removeLeaf(leaf);
+    freeNode(leaf);
+}
+
+void ObjectBvh::move(int leaf, const glm::vec3& boxMin, const glm::vec3& boxMax) {
+    removeLeaf(leaf);
+    m_nodes[leaf].boxMin = boxMin;
+    m_nodes[leaf].boxMax = boxMax;
+    insertLeaf(leaf);
+}
+
+void ObjectBvh::clear() {
+    m_nodes.clear();
+    m_root = -1;
+    m_freeList = -1;
+}
+
+void ObjectBvh::insertLeaf(int leaf) {
+    if (m_root == -1) {
+        m_root = leaf;
+        m_nodes[leaf].parent = -1;
+        return;
+    }
+
+    // descend towards the cheapest sibling: pairing with a node costs the area of
+    // the new parent, and every ancestor on the way grows by the leaf as well
+    glm::vec3 leafMin = m_nodes[leaf].boxMin;
+    glm::vec3 leafMax = m_nodes[leaf].boxMax;
+    int index = m_root;
+    while (m_nodes[index].child1 != -1) {
+        const Node& node = m_nodes[index];
+        float area = surfaceArea(node.boxMin, node.boxMax);
+        float combinedArea = unionArea(node.boxMin, node.boxMax, leafMin, leafMax);
+        float siblingCost = 2.0f * combinedArea;
+        float inheritanceCost = 2.0f * (combinedArea - area);
+
+        float childCosts[2];
+        int children[2] = {node.child1, node.child2};
+        for (int i = 0; i < 2; i++) {
+            const Node& child = m_nodes[children[i]];
+            float grown = unionArea(child.boxMin, child.boxMax, leafMin, leafMax);
+            if (child.child1 != -1) grown -= surfaceArea(child.boxMin, child.boxMax);
+            childCosts[i] = grown + inheritanceCost;
+        }
+
+        if (siblingCost < childCosts[0] && siblingCost < childCosts[1]) break;
+        index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+    }
+
+    int sibling = index;
+    int oldParent = m_nodes[sibling].parent;
+    int newParent = allocateNode();
+    m_nodes[newParent].parent = oldParent;
+    m_nodes[newParent].child1 = sibling;
+    m_nodes[newParent].child2 = leaf;
+    m_nodes[sibling].parent = newParent;
+    m_nodes[leaf].parent = newParent;
+
+    if (oldParent == -1) {
+        m_root = newParent;
+    }
+    else if (m_nodes[oldParent].child1 == sibling) {
+        m_nodes[oldParent].child1 = newParent;
+    }
+    else {
+        m_nodes[oldParent].child2 = newParent;
+    }
+
+    for (int node = newParent; node != -1; node = m_nodes[node].parent) {
+        refit(node);
+        rotate(node);
+    }
+}
+
+void ObjectBvh::removeLeaf(int leaf) {
+    if (leaf == m_root) {
+        m_root = -1;
+        return;
+    }
+
+    // the sibling takes the parent's place
+    int parent = m_nodes[leaf].parent;
+    int grandParent = m_nodes[parent].parent;
+    int sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+    freeNode(parent);
+
+    m_nodes[sibling].parent = grandParent;
+    if (grandParent == -1) {
+        m_root = sibling;
+        return;
+    }
+    if (m_nodes[grandParent].child1 == parent) {
+        m_nodes[grandParent].child1 = sibling;
+    }
+    else {
+        m_nodes[grandParent].child2 = sibling;
+    }
+
+    for (int node = grandParent; node != -1; node = m_nodes[node].parent) {
+        refit(node);
+        rotate(node);
+    }
+}
+
+void ObjectBvh::refit(int node) {
+    Node& n = m_nodes[node];
+    const Node& a = m_nodes[n.child1];
+    const Node& b = m_nodes[n.child2];
+    n.boxMin = glm::min(a.boxMin, b.boxMin);
+    n.boxMax = glm::max(a.boxMax, b.boxMax);
+    n.height = 1 + std::max(a.height, b.height);
+}
+
+// Tries swapping a child of the node with a grandchild under its other child, and
+// keeps the swap that shrinks the box of the child that changes the most
+void ObjectBvh::rotate(int node) {
+    int children[2] = {m_nodes[node].child1, m_nodes[node].child2};
+
+    float bestGain = 0.0f;
+    int bestUpper = -1;     // child of node that moves down
+    int bestLower = -1;     // grandchild that moves up
+    for (int i = 0; i < 2; i++) {
+        int upper = children[i];
+        const Node& other = m_nodes[children[1 - i]];
+        if (other.child1 == -1) continue;
+
+        float area = surfaceArea(other.boxMin, other.boxMax);
+        int grandChildren[2] = {other.child1, other.child2};
+        for (int j = 0; j < 2; j++) {
+            // upper swaps with grandChildren[j] and pairs with grandChildren[1 - j]
+            const Node& kept = m_nodes[grandChildren[1 - j]];
+            float gain = area - unionArea(m_nodes[upper].boxMin, m_nodes[upper].boxMax, kept.boxMin, kept.boxMax);
+            if (gain > bestGain) {
+                bestGain = gain;
+                bestUpper = upper;
+                bestLower = grandChildren[j];
+            }
+        }
+    }
+    if (bestUpper == -1) return;
+
+    int lowerParent = m_nodes[bestLower].parent;
+    Node& n = m_nodes[node];
+    if (n.child1 == bestUpper) n.child1 = bestLower;
+    else n.child2 = bestLower;
+    m_nodes[bestLower].parent = node;
+
+    Node& p = m_nodes[lowerParent];
+    if (p.child1 == bestLower) p.child1 = bestUpper;
+    else p.child2 = bestUpper;
+    m_nodes[bestUpper].parent = lowerParent;
+
+    refit(lowerParent);
+    refit(node);
+}
+
+int ObjectBvh::raycast(const glm::vec3& origin, const glm::vec3& dir, float& t,
+                       const std::function<bool(int, float&)>& hitObject) const {
+    if (m_root == -1) return -1;
+
+    glm::vec3 invDir = 1.0f / dir;
+    struct Entry {
+        int node;
+        float tEnter;
+    };
+    std::vector<Entry> stack;
+    stack.reserve(64);
+
+    float rootEnter = rayBoxEntry(origin, invDir, m_nodes[m_root].boxMin, m_nodes[m_root].boxMax, t);
+    if (rootEnter == INFINITY) return -1;
+    stack.push_back({m_root, rootEnter});
+
+    int hit = -1;
+    while (!stack.empty()) {
+        Entry entry = stack.back();
+        stack.pop_back();
+        if (entry.tEnter > t) continue;
+
+        const Node& node = m_nodes[entry.node];
+        if (node.child1 == -1) {
+            if (hitObject(node.object, t)) hit = node.object;
+            continue;
+        }
+
+        // push the far child first so the near one is visited first
+        float t1 = rayBoxEntry(origin, invDir, m_nodes[node.child1].boxMin, m_nodes[node.child1].boxMax, t);
+        float t2 = rayBoxEntry(origin, invDir, m_nodes[node.child2].boxMin, m_nodes[node.child2].boxMax, t);
+        Entry near = {node.child1, t1};
+        Entry far = {node.child2, t2};
+        if (t2 < t1) std::swap(near, far);
+        if (far.tEnter != INFINITY) stack.push_back(far);
+        if (near.tEnter != INFINITY) stack.push_back(near);
+    }
+    return hit;
+}
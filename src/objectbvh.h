@@ -0,0 +1,57 @@
+#ifndef OBJECTBVH_H
+#define OBJECTBVH_H
+
+#include <functional>
+#include <vector>
+#include "glm/glm.hpp"
+
+// Dynamic bounding-volume hierarchy over the placed terrain objects' boxes.
+//
+// Leaves are added and removed one at a time, so placing or deleting an object
+// never rebuilds the tree. A new leaf goes next to the sibling that grows the
+// total box surface area the least. Ancestors are refit on the way back up and
+// rotated when that lowers their children's area, which keeps objects placed
+// along a stroke from stacking into a list.
+class ObjectBvh
+{
+public:
+    ObjectBvh();
+
+    // Returns the leaf id, which stays valid until the leaf is removed
+    int insert(const glm::vec3& boxMin, const glm::vec3& boxMax, int object);
+    void remove(int leaf);
+    void move(int leaf, const glm::vec3& boxMin, const glm::vec3& boxMax);
+    void clear();
+
+    void setObject(int leaf, int object) { m_nodes[leaf].object = object; }
+
+    // Nearest hit along origin + t * dir, t in (0, t]. Leaves are visited nearest box
+    // first; hitObject(object, t) does the exact test and, on a hit, lowers t and
+    // returns true. Returns the hit object, or -1.
+    int raycast(const glm::vec3& origin, const glm::vec3& dir, float& t,
+                const std::function<bool(int, float&)>& hitObject) const;
+
+private:
+    struct Node {
+        glm::vec3 boxMin;
+        glm::vec3 boxMax;
+        int parent;     // next free node while on the free list
+        int child1;     // -1 for leaves
+        int child2;
+        int object;
+        int height;     // 0 for leaves
+    };
+
+    int allocateNode();
+    void freeNode(int node);
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+    void refit(int node);
+    void rotate(int node);
+
+    std::vector<Node> m_nodes;
+    int m_root = -1;
+    int m_freeList = -1;
+};
+
+#endif // OBJECTBVH_H
@@ -0,0 +1,72 @@
+#include "rakebrush.h"
+
+#include <cmath>
+
+RakeBrush::RakeBrush()
+{
+    m_last = glm::vec2(0.0f);
+    m_across = glm::vec2(1.0f, 0.0f);
+}
+
+void RakeBrush::beginStroke(glm::vec2 p) {
+    // no direction yet; spread the tines along x until the drag picks one
+    m_last = p;
+    m_across = glm::vec2(1.0f, 0.0f);
+    m_sinceLastStamp = 0.0f;
+    m_pending.push_back({p, m_across});
+}
+
+void RakeBrush::moveTo(glm::vec2 p) {
+    glm::vec2 segment = p - m_last;
+    float length = glm::length(segment);
+    if (length <= 0.0f) return;
+
+    glm::vec2 dir = segment / length;
+    m_across = glm::vec2(-dir.y, dir.x);
+
+    // distance along this segment of the next stamp
+    float t = m_params.stampSpacing - m_sinceLastStamp;
+    while (t <= length) {
+        m_pending.push_back({m_last + dir * t, m_across});
+        t += m_params.stampSpacing;
+    }
+    m_sinceLastStamp = length - (t - m_params.stampSpacing);
+    m_last = p;
+}
+
+// Tines sit symmetrically around the stamp center
+glm::vec2 RakeBrush::tineCenter(const Stamp& stamp, int tine) {
+    float offset = (tine - 0.5f * (m_params.tineCount - 1)) * m_params.tineSpacing;
+    return stamp.center + stamp.across * offset;
+}
+
+bool RakeBrush::getPendingBounds(glm::vec2& minCorner, glm::vec2& maxCorner) {
+    if (m_pending.empty()) return false;
+
+    minCorner = glm::vec2(INFINITY);
+    maxCorner = glm::vec2(-INFINITY);
+    for (const Stamp& stamp : m_pending) {
+        for (int tine = 0; tine < m_params.tineCount; tine++) {
+            glm::vec2 c = tineCenter(stamp, tine);
+            minCorner = glm::min(minCorner, c);
+            maxCorner = glm::max(maxCorner, c);
+        }
+    }
+    minCorner -= m_params.tineRadius;
+    maxCorner += m_params.tineRadius;
+    return true;
+}
+
+void RakeBrush::applyPending(Terrain& terrain) {
+    for (const Stamp& stamp : m_pending) {
+        for (int tine = 0; tine < m_params.tineCount; tine++) {
+            glm::vec2 c = tineCenter(stamp, tine);
+
+            // tines off the edge of the garden leave no mark
+            if (c.x >= 0.0f && c.x <= 1.0f && c.y >= 0.0f && c.y <= 1.0f) {
+                terrain.divot(c.x, c.y, m_params.stampDepth, m_params.tineRadius);
+            }
+        }
+    }
+    m_pending.clear();
+}
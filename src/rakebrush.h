@@ -0,0 +1,53 @@
+#ifndef RAKEBRUSH_H
+#define RAKEBRUSH_H
+
+#include <vector>
+#include "glm/glm.hpp"
+#include "terrain.h"
+
+struct RakeParams {
+    int tineCount = 4;
+    float tineSpacing = 0.05f;      // distance between neighbouring tines
+    float tineRadius = 0.01f;       // radius of each tine's divot
+    float stampDepth = 0.002f;      // depth of one stamp; overlapping stamps add up to ~0.005 along a groove
+    float stampSpacing = 0.004f;    // arc length between stamps
+};
+
+// Turns a mouse drag into rake stamps. The path is resampled at a fixed arc length
+// and each stamp lays the tines out perpendicular to the direction of travel, so
+// grooves come out the same however many move events the drag produced.
+// Stamps are queued until applyPending(), which the widget calls once per frame.
+class RakeBrush
+{
+public:
+    RakeBrush();
+
+    void setParams(const RakeParams& params) { m_params = params; }
+    const RakeParams& getParams() { return m_params; }
+
+    // Starts a stroke and stamps once at p (normalized terrain coordinates)
+    void beginStroke(glm::vec2 p);
+    // Extends the stroke to p, queuing a stamp every stampSpacing along the way
+    void moveTo(glm::vec2 p);
+
+    // Box covering every queued tine, including its radius; false when nothing is queued
+    bool getPendingBounds(glm::vec2& minCorner, glm::vec2& maxCorner);
+    // Presses all queued stamps into the terrain and clears the queue
+    void applyPending(Terrain& terrain);
+
+private:
+    struct Stamp {
+        glm::vec2 center;
+        glm::vec2 across;   // unit vector the tines are spread along
+    };
+
+    glm::vec2 tineCenter(const Stamp& stamp, int tine);
+
+    RakeParams m_params;
+    glm::vec2 m_last;
+    glm::vec2 m_across;
+    float m_sinceLastStamp = 0.0f;  // arc length travelled since the last stamp
+    std::vector<Stamp> m_pending;
+};
+
+#endif // RAKEBRUSH_H
@@ -4,10 +4,13 @@
 #include <QMouseEvent>
 #include <QKeyEvent>
 #include <iostream>
+#include <algorithm>
+#include <cstring>
 #include "settings.h"
 #include "glm/gtc/matrix_transform.hpp"
 #include "mouse.h"
 #include "terrain.h"
+#include "gardenfile.h"
 
 // ================== Rendering the Scene!
 
@@ -63,6 +66,11 @@ void Realtime::makeShapes() {
     m_cone_data = Cone(settings.shapeParameter1,settings.shapeParameter2).getVertexData();
     m_cube_data = Cube(settings.shapeParameter1,settings.shapeParameter2).getVertexData();
     m_cylinder_data = Cylinder(settings.shapeParameter1,settings.shapeParameter2).getVertexData();
+
+    m_sphere_packets = packTriangles(m_sphere_data, 6);
+    m_cone_packets = packTriangles(m_cone_data, 6);
+    m_cube_packets = packTriangles(m_cube_data, 6);
+    m_cylinder_packets = packTriangles(m_cylinder_data, 6);
 }
 
 void Realtime::updateShapes() {
@@ -110,13 +118,32 @@ void Realtime::finish() {
     if (m_terrainVao.isCreated()) {
         m_terrainVao.destroy();
     }
-    if (m_terrainVbo.isCreated()) {
-        m_terrainVbo.destroy();
+    if (m_terrainIbo.isCreated()) {
+        m_terrainIbo.destroy();
+    }
+    if (m_terrainInstanceVbo.isCreated()) {
+        m_terrainInstanceVbo.destroy();
     }
+    glDeleteTextures(1, &m_terrainHeightTexture);
     if (m_terrainProgram) {
         delete m_terrainProgram;
         m_terrainProgram = nullptr;
     }
+    if (m_terrainTessVao.isCreated()) {
+        m_terrainTessVao.destroy();
+    }
+    if (m_terrainTessVbo.isCreated()) {
+        m_terrainTessVbo.destroy();
+    }
+    if (m_terrainTessProgram) {
+        delete m_terrainTessProgram;
+        m_terrainTessProgram = nullptr;
+    }
+    m_gpuPicker.destroy();
+    delete m_terrainPickProgram;
+    m_terrainPickProgram = nullptr;
+    delete m_objectPickProgram;
+    m_objectPickProgram = nullptr;
 
     // Terrain objects cleanup
     for (const TerrainObject& obj : m_terrainObjects) {
@@ -124,6 +151,7 @@ void Realtime::finish() {
         glDeleteVertexArrays(1, &obj.vao);
     }
     m_terrainObjects.clear();
+    m_objectBvh.clear();
 
     this->doneCurrent();
 }
@@ -217,9 +245,13 @@ void Realtime::cacheUniformLocations() {
     glUseProgram(0);
 }
 
+// Helpers every terrain stage shares, spliced into each by ShaderLoader::readShaderSource
+static const char *kTerrainCommonShader = ":/resources/shaders/terrain_common.glsl";
+
 void Realtime::initializeTerrain() {
     m_terrainProgram = new QOpenGLShaderProgram;
-    m_terrainProgram->addShaderFromSourceFile(QOpenGLShader::Vertex,":/resources/shaders/terrain.vert");
+    m_terrainProgram->addShaderFromSourceCode(QOpenGLShader::Vertex,
+        ShaderLoader::readShaderSource(":/resources/shaders/terrain.vert", kTerrainCommonShader));
     m_terrainProgram->addShaderFromSourceFile(QOpenGLShader::Fragment,":/resources/shaders/terrain.frag");
     m_terrainProgram->link();
     m_terrainProgram->bind();
@@ -227,28 +259,52 @@ void Realtime::initializeTerrain() {
     m_terrainProjMatrixLoc = m_terrainProgram->uniformLocation("projMatrix");
     m_terrainMvMatrixLoc = m_terrainProgram->uniformLocation("mvMatrix");
     m_terrainWireshadeLoc = m_terrainProgram->uniformLocation("wireshade");
+    m_terrainGridResolutionLoc = m_terrainProgram->uniformLocation("gridResolution");
+    m_terrainSandColorLoc = m_terrainProgram->uniformLocation("sandColor");
+    m_terrainColorHeightMinLoc = m_terrainProgram->uniformLocation("colorHeightMin");
+    m_terrainColorHeightMaxLoc = m_terrainProgram->uniformLocation("colorHeightMax");
+    m_terrainPatchLocs.heightMap = m_terrainProgram->uniformLocation("heightMap");
+    m_terrainPatchLocs.patchResolution = m_terrainProgram->uniformLocation("patchResolution");
+    m_terrainPatchLocs.cameraPosition = m_terrainProgram->uniformLocation("cameraPosition");
+    m_terrainPatchLocs.morphRanges = m_terrainProgram->uniformLocation("morphRanges");
 
     m_terrainVao.create();
     m_terrainVao.bind();
 
-    m_terrainVerts = m_terrain.generateTerrain();
-
-    m_terrainVbo.create();
-    m_terrainVbo.bind();
-    glBufferData(GL_ARRAY_BUFFER, m_terrainVerts.size() * sizeof(GLfloat),
-                 m_terrainVerts.data(), GL_DYNAMIC_DRAW);
+    int gridSide = m_terrain.getGridSide();
+    m_terrainHeights.assign(m_terrain.getGridSampleCount(), 0.0f);
+    m_terrain.readHeights(-1, gridSide - 1, -1, gridSide - 1, m_terrainHeights);
+    m_heightPyramid.build(m_terrainHeights, m_terrain.getResolution());
+    rebuildTileBounds();
+
+    // grid sample (row, col) is texel (col + 1, row + 1); the apron lets terrain.vert
+    // take central differences for normals at the edge
+    glGenTextures(1, &m_terrainHeightTexture);
+    glBindTexture(GL_TEXTURE_2D, m_terrainHeightTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, gridSide, gridSide, 0, GL_RED, GL_FLOAT, m_terrainHeights.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
 
+    // one (originRow, originCol, stride, level) record per patch instance
+    m_terrainInstanceVbo.create();
+    m_terrainInstanceVbo.bind();
     glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), reinterpret_cast<void *>(0));
+    glVertexAttribDivisor(0, 1);
+    m_terrainInstanceVbo.release();
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), nullptr);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat),
-                          reinterpret_cast<void *>(3 * sizeof(GLfloat)));
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat),
-                          reinterpret_cast<void *>(6 * sizeof(GLfloat)));
+    // index buffer binding is recorded in the VAO, so it stays bound until the VAO is released
+    std::vector<GLuint> patchIndices = m_terrainQuadtree.generatePatchIndices();
+    m_terrainPatchIndexCount = patchIndices.size();
+    m_terrainIbo.create();
+    m_terrainIbo.bind();
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, patchIndices.size() * sizeof(GLuint),
+                 patchIndices.data(), GL_STATIC_DRAW);
 
-    m_terrainVbo.release();
+    m_terrainVao.release();
 
     m_terrainWorld.setToIdentity();
     m_terrainWorld.translate(QVector3D(-0.5,-0.5,0));
@@ -258,6 +314,84 @@ void Realtime::initializeTerrain() {
 
     m_terrainProgram->release();
     rebuildTerrainMatrices();
+
+    initializeTessellatedTerrain();
+    initializeGpuPicking();
+}
+
+// On-screen length each tessellated edge segment aims for
+static constexpr float kTessPixelsPerSegment = 8.0f;
+
+// The tessellated path needs GL 4.0 tessellation stages; when its shaders don't
+// build, the CDLOD path stays the only one
+void Realtime::initializeTessellatedTerrain() {
+    m_terrainTessProgram = new QOpenGLShaderProgram;
+    m_tessellationSupported =
+        m_terrainTessProgram->addShaderFromSourceFile(QOpenGLShader::Vertex, ":/resources/shaders/terrain_tess.vert") &&
+        m_terrainTessProgram->addShaderFromSourceCode(QOpenGLShader::TessellationControl,
+            ShaderLoader::readShaderSource(":/resources/shaders/terrain.tesc", kTerrainCommonShader)) &&
+        m_terrainTessProgram->addShaderFromSourceCode(QOpenGLShader::TessellationEvaluation,
+            ShaderLoader::readShaderSource(":/resources/shaders/terrain.tese", kTerrainCommonShader)) &&
+        m_terrainTessProgram->addShaderFromSourceFile(QOpenGLShader::Fragment, ":/resources/shaders/terrain.frag") &&
+        m_terrainTessProgram->link();
+    if (!m_tessellationSupported) {
+        std::cerr << "Terrain tessellation unavailable; using the LOD patch path only" << std::endl;
+        return;
+    }
+
+    m_terrainTessLocs.projMatrix = m_terrainTessProgram->uniformLocation("projMatrix");
+    m_terrainTessLocs.mvMatrix = m_terrainTessProgram->uniformLocation("mvMatrix");
+    m_terrainTessLocs.wireshade = m_terrainTessProgram->uniformLocation("wireshade");
+    m_terrainTessLocs.gridResolution = m_terrainTessProgram->uniformLocation("gridResolution");
+    m_terrainTessLocs.heightMap = m_terrainTessProgram->uniformLocation("heightMap");
+    m_terrainTessLocs.viewportSize = m_terrainTessProgram->uniformLocation("viewportSize");
+    m_terrainTessLocs.pixelsPerSegment = m_terrainTessProgram->uniformLocation("pixelsPerSegment");
+    m_terrainTessLocs.maxTessLevel = m_terrainTessProgram->uniformLocation("maxTessLevel");
+    m_terrainTessLocs.sandColor = m_terrainTessProgram->uniformLocation("sandColor");
+    m_terrainTessLocs.colorHeightMin = m_terrainTessProgram->uniformLocation("colorHeightMin");
+    m_terrainTessLocs.colorHeightMax = m_terrainTessProgram->uniformLocation("colorHeightMax");
+
+    // tile t is patch vertices [4t, 4t + 4), corners in the order terrain.tesc expects
+    int tilesPerSide = m_terrain.getTilesPerSide();
+    int tileResolution = m_terrain.getTileResolution();
+    std::vector<glm::vec2> corners;
+    corners.reserve(tilesPerSide * tilesPerSide * 4);
+    for (int tileIndex = 0; tileIndex < tilesPerSide * tilesPerSide; tileIndex++) {
+        float row = (tileIndex % tilesPerSide) * tileResolution;
+        float col = (tileIndex / tilesPerSide) * tileResolution;
+        corners.push_back(glm::vec2(row, col));
+        corners.push_back(glm::vec2(row + tileResolution, col));
+        corners.push_back(glm::vec2(row + tileResolution, col + tileResolution));
+        corners.push_back(glm::vec2(row, col + tileResolution));
+    }
+
+    m_terrainTessVao.create();
+    m_terrainTessVao.bind();
+    m_terrainTessVbo.create();
+    m_terrainTessVbo.bind();
+    glBufferData(GL_ARRAY_BUFFER, corners.size() * sizeof(glm::vec2), corners.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), reinterpret_cast<void *>(0));
+    m_terrainTessVbo.release();
+    m_terrainTessVao.release();
+}
+
+// Vertical field of view of the terrain camera, in degrees
+static constexpr float kTerrainFovY = 45.0f;
+// On-screen size a full-resolution terrain cell may shrink to before a coarser LOD takes over
+static constexpr float kLodPixelsPerCell = 4.0f;
+
+// Level 0 reaches as far as one grid cell still covers kLodPixelsPerCell pixels;
+// each coarser level doubles the cell size, and with it the distance
+void Realtime::updateTerrainLodRange() {
+    float viewportHeight = height() * m_devicePixelRatio;
+    float cellSize = 1.0f / m_terrain.getResolution();
+    float baseRange = cellSize * viewportHeight /
+                      (2.0f * std::tan(glm::radians(kTerrainFovY) * 0.5f) * kLodPixelsPerCell);
+
+    // never below two tiles, so neighbouring nodes stay within one level of each other
+    float tileSize = (float)m_terrain.getTileResolution() / m_terrain.getResolution();
+    m_terrainQuadtree.setBaseRange(std::max(baseRange, 2.0f * tileSize));
 }
 
 void Realtime::rebuildTerrainMatrices() {
@@ -276,7 +410,8 @@ void Realtime::rebuildTerrainMatrices() {
     m_terrainCamera.lookAt(eye, QVector3D(0, 0, 0), QVector3D(0, 0, 1));
 
     m_terrainProj.setToIdentity();
-    m_terrainProj.perspective(45.0f, 1.0 * width() / height(), 0.01f, 100.0f);
+    m_terrainProj.perspective(kTerrainFovY, 1.0 * width() / height(), 0.01f, 100.0f);
+    updateTerrainLodRange();
 
     for (int i = 0; i < 4; ++i) {
         for (int j = 0; j < 4; ++j) {
@@ -285,42 +420,290 @@ void Realtime::rebuildTerrainMatrices() {
             m_terrainWorldMatrix[i][j] = m_terrainWorld(j, i);
         }
     }
+    m_pickSceneVersion++;
 }
 
+// Refreshes the height copy and tile bounds of the tiles right away, and queues
+// their texels for upload by the next paintGL. Normals come from the height texture
+// in terrain.vert, so nothing else needs rebuilding.
 void Realtime::updateAffectedTiles(const std::unordered_set<int>& affectedTiles) {
     if (affectedTiles.empty()) return;
 
+    int tilesPerSide = m_terrain.getTilesPerSide();
+    std::unordered_set<int> boundsTiles;
     for (int tileIndex : affectedTiles) {
-        int tilesPerSide = m_terrain.getTilesPerSide();
         int tileX = tileIndex % tilesPerSide;
         int tileY = tileIndex / tilesPerSide;
 
-        m_terrain.updateTile(tileX, tileY, m_terrainVerts);
+        int startRow, endRow, startCol, endCol;
+        m_terrain.getTileGridRange(tileX, tileY, startRow, endRow, startCol, endCol);
+        m_terrain.readHeights(startRow, endRow, startCol, endCol, m_terrainHeights);
+        m_heightPyramid.updateRect(m_terrainHeights, startRow, endRow, startCol, endCol);
+        markHeightsDirty(startRow, endRow, startCol, endCol);
+
+        // a tile's cells reach the first row/column of the next tiles, so its heights
+        // also move the bounds of the tiles before it in x and y
+        for (int tx = std::max(0, tileX - 1); tx <= tileX; tx++) {
+            for (int ty = std::max(0, tileY - 1); ty <= tileY; ty++) {
+                boundsTiles.insert(ty * tilesPerSide + tx);
+            }
+        }
     }
 
-    m_terrainVbo.bind();
-    glBufferSubData(GL_ARRAY_BUFFER, 0, m_terrainVerts.size() * sizeof(GLfloat),
-                    m_terrainVerts.data());
-    m_terrainVbo.release();
+    for (int tileIndex : boundsTiles) {
+        m_terrainQuadtree.updateTile(tileIndex, m_terrain.getTileBounds(tileIndex % tilesPerSide, tileIndex / tilesPerSide,
+                                                                        m_terrainHeights));
+    }
 }
 
 void Realtime::updateAffectedTiles(float x, float y, float radius) {
     std::vector<int> affectedTiles = m_terrain.getAffectedTiles(x, y, radius);
+    updateAffectedTiles(std::unordered_set<int>(affectedTiles.begin(), affectedTiles.end()));
+}
 
-    if (affectedTiles.empty()) return;
+// Grows the rectangle of grid samples waiting for upload
+void Realtime::markHeightsDirty(int startRow, int endRow, int startCol, int endCol) {
+    m_pickSceneVersion++;
+    if (!m_heightsDirty) {
+        m_dirtyStartRow = startRow;
+        m_dirtyEndRow = endRow;
+        m_dirtyStartCol = startCol;
+        m_dirtyEndCol = endCol;
+        m_heightsDirty = true;
+        return;
+    }
+    m_dirtyStartRow = std::min(m_dirtyStartRow, startRow);
+    m_dirtyEndRow = std::max(m_dirtyEndRow, endRow);
+    m_dirtyStartCol = std::min(m_dirtyStartCol, startCol);
+    m_dirtyEndCol = std::max(m_dirtyEndCol, endCol);
+}
 
-    for (int tileIndex : affectedTiles) {
-        int tilesPerSide = m_terrain.getTilesPerSide();
-        int tileX = tileIndex % tilesPerSide;
-        int tileY = tileIndex / tilesPerSide;
+// Draws the tiles in the frustum as tessellated patches. Edges are split so each
+// segment covers about kTessPixelsPerSegment pixels, up to the height grid's own
+// resolution, since finer segments would only interpolate between samples.
+void Realtime::drawTessellatedTerrain() {
+    glm::mat4 modelView = m_terrainViewMatrix * m_terrainWorldMatrix;
+    Frustum frustum;
+    frustum.setFromMatrix(m_terrainProjMatrix * modelView);
+
+    m_visibleTiles.clear();
+    m_terrainQuadtree.selectTiles(frustum, m_visibleTiles);
+    if (m_visibleTiles.empty()) return;
+
+    m_tilePatchFirsts.clear();
+    m_tilePatchCounts.clear();
+    for (int tileIndex : m_visibleTiles) {
+        m_tilePatchFirsts.push_back(tileIndex * 4);
+        m_tilePatchCounts.push_back(4);
+    }
+
+    m_terrainTessProgram->bind();
+    m_terrainTessProgram->setUniformValue(m_terrainTessLocs.projMatrix, m_terrainProj);
+    m_terrainTessProgram->setUniformValue(m_terrainTessLocs.mvMatrix, m_terrainCamera * m_terrainWorld);
+    m_terrainTessProgram->setUniformValue(m_terrainTessLocs.wireshade, m_terrain.m_wireshade);
+    m_terrainTessProgram->setUniformValue(m_terrainTessLocs.gridResolution, m_terrain.getResolution());
+    m_terrainTessProgram->setUniformValue(m_terrainTessLocs.viewportSize, (float)(width() * m_devicePixelRatio),
+                                          (float)(height() * m_devicePixelRatio));
+    m_terrainTessProgram->setUniformValue(m_terrainTessLocs.pixelsPerSegment, kTessPixelsPerSegment);
+    m_terrainTessProgram->setUniformValue(m_terrainTessLocs.maxTessLevel, (float)m_terrain.getTileResolution());
+    glm::vec3 sandColor = m_terrain.getSandColor();
+    m_terrainTessProgram->setUniformValue(m_terrainTessLocs.sandColor, sandColor.r, sandColor.g, sandColor.b);
+    m_terrainTessProgram->setUniformValue(m_terrainTessLocs.colorHeightMin, m_terrain.getColorHeightMin());
+    m_terrainTessProgram->setUniformValue(m_terrainTessLocs.colorHeightMax, m_terrain.getColorHeightMax());
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, m_terrainHeightTexture);
+    m_terrainTessProgram->setUniformValue(m_terrainTessLocs.heightMap, 1);
+
+    m_terrainTessVao.bind();
+    glPolygonMode(GL_FRONT_AND_BACK, m_terrain.m_wireshade ? GL_LINE : GL_FILL);
+    glPatchParameteri(GL_PATCH_VERTICES, 4);
+    glMultiDrawArrays(GL_PATCHES, m_tilePatchFirsts.data(), m_tilePatchCounts.data(), m_tilePatchFirsts.size());
+    m_terrainTessVao.release();
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    m_terrainTessProgram->release();
+}
+
+void Realtime::initializeGpuPicking() {
+    m_terrainPickProgram = new QOpenGLShaderProgram;
+    m_terrainPickProgram->addShaderFromSourceCode(QOpenGLShader::Vertex,
+        ShaderLoader::readShaderSource(":/resources/shaders/terrain.vert", kTerrainCommonShader));
+    m_terrainPickProgram->addShaderFromSourceFile(QOpenGLShader::Fragment, ":/resources/shaders/pick.frag");
+    m_terrainPickProgram->link();
+    m_pickLocs.terrainProjMatrix = m_terrainPickProgram->uniformLocation("projMatrix");
+    m_pickLocs.terrainMvMatrix = m_terrainPickProgram->uniformLocation("mvMatrix");
+    m_pickLocs.terrainGridResolution = m_terrainPickProgram->uniformLocation("gridResolution");
+    m_pickLocs.terrainPickId = m_terrainPickProgram->uniformLocation("pickId");
+    m_terrainPickPatchLocs.heightMap = m_terrainPickProgram->uniformLocation("heightMap");
+    m_terrainPickPatchLocs.patchResolution = m_terrainPickProgram->uniformLocation("patchResolution");
+    m_terrainPickPatchLocs.cameraPosition = m_terrainPickProgram->uniformLocation("cameraPosition");
+    m_terrainPickPatchLocs.morphRanges = m_terrainPickProgram->uniformLocation("morphRanges");
+
+    m_objectPickProgram = new QOpenGLShaderProgram;
+    m_objectPickProgram->addShaderFromSourceFile(QOpenGLShader::Vertex, ":/resources/shaders/pick.vert");
+    m_objectPickProgram->addShaderFromSourceFile(QOpenGLShader::Fragment, ":/resources/shaders/pick.frag");
+    m_objectPickProgram->link();
+    m_pickLocs.objectMvp = m_objectPickProgram->uniformLocation("mvp");
+    m_pickLocs.objectPickId = m_objectPickProgram->uniformLocation("pickId");
+
+    m_gpuPicker.initialize();
+}
+
+// Draws terrain and object IDs for the pixel under the cursor. The result comes
+// back through pollGpuPick() a frame or so later. Returns false when the picker
+// had no free readback slot and nothing was drawn.
+bool Realtime::renderPickPass() {
+    int viewportWidth = width() * m_devicePixelRatio;
+    int viewportHeight = height() * m_devicePixelRatio;
+    glm::mat4 pickMatrix;
+    glm::ivec2 pixel = pickPixel(m_pickCursor);
+
+    // the frame may be going to an offscreen target (saveViewportImage), so put back
+    // whatever was bound rather than the widget's framebuffer
+    GLint previousFramebuffer;
+    GLint previousViewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+    if (!m_gpuPicker.beginPass(pixel.x, pixel.y, viewportWidth, viewportHeight, pickMatrix)) {
+        return false;
+    }
+    glm::mat4 viewProj = m_terrainProjMatrix * m_terrainViewMatrix;
+
+    glEnable(GL_DEPTH_TEST);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    // the tessellated path doesn't select LOD patches, so the pick pass does its own
+    if (m_tessellateTerrain) selectTerrainPatches();
+
+    glm::mat4 pickProj = pickMatrix * m_terrainProjMatrix;
+    glm::mat4 modelView = m_terrainViewMatrix * m_terrainWorldMatrix;
+    m_terrainPickProgram->bind();
+    glUniformMatrix4fv(m_pickLocs.terrainProjMatrix, 1, GL_FALSE, &pickProj[0][0]);
+    glUniformMatrix4fv(m_pickLocs.terrainMvMatrix, 1, GL_FALSE, &modelView[0][0]);
+    glUniform1i(m_pickLocs.terrainGridResolution, m_terrain.getResolution());
+    glUniform1ui(m_pickLocs.terrainPickId, GpuPicker::kTerrainId);
+    m_terrainVao.bind();
+    drawTerrainPatches(m_terrainPickPatchLocs);
+    m_terrainVao.release();
+    m_terrainPickProgram->release();
+
+    m_objectPickProgram->bind();
+    for (size_t i = 0; i < m_terrainObjects.size(); i++) {
+        const TerrainObject& obj = m_terrainObjects[i];
+        glm::mat4 mvp = pickMatrix * viewProj * m_terrainWorldMatrix * obj.modelMatrix;
+        glUniformMatrix4fv(m_pickLocs.objectMvp, 1, GL_FALSE, &mvp[0][0]);
+        glUniform1ui(m_pickLocs.objectPickId, GpuPicker::kFirstObjectId + i);
+        glBindVertexArray(obj.vao);
+        glDrawArrays(GL_TRIANGLES, 0, obj.vertexCount);
+    }
+    glBindVertexArray(0);
+    m_objectPickProgram->release();
+
+    m_gpuPicker.endPass(viewProj, m_pickSceneVersion);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    return true;
+}
+
+// Takes the latest landed pick as the hover state
+void Realtime::pollGpuPick() {
+    GpuPickResult result;
+    if (m_gpuPicker.poll(result)) {
+        m_lastPick = result;
+        m_hasLastPick = true;
+
+        int hovered = result.id >= GpuPicker::kFirstObjectId ? (int)(result.id - GpuPicker::kFirstObjectId) : -1;
+        if (hovered >= (int)m_terrainObjects.size()) hovered = -1;
+        if (hovered != m_hoveredObject) {
+            m_hoveredObject = hovered;
+            update();
+        }
+    }
+
+    // keep frames coming until the readback lands
+    if (m_gpuPicker.isPending()) update();
+}
+
+// Device pixel (origin bottom-left) under a cursor position in widget coordinates
+glm::ivec2 Realtime::pickPixel(glm::ivec2 cursor) {
+    int viewportHeight = height() * m_devicePixelRatio;
+    return glm::ivec2(cursor.x * m_devicePixelRatio, viewportHeight - 1 - cursor.y * m_devicePixelRatio);
+}
+
+// The latest landed pick, if it was taken under this cursor and nothing has moved
+// or changed shape since its pass was drawn
+bool Realtime::currentGpuPick(glm::ivec2 cursor, GpuPickResult& result) {
+    if (!m_gpuPicking || !m_hasLastPick) return false;
+    if (m_lastPick.tag != m_pickSceneVersion || m_lastPick.pixel != pickPixel(cursor)) return false;
+    result = m_lastPick;
+    return true;
+}
+
+// Uploads the dirty rectangle with one glTexSubImage2D, reading it in place from
+// the height copy
+void Realtime::uploadDirtyHeights() {
+    if (!m_heightsDirty) return;
 
-        m_terrain.updateTile(tileX, tileY, m_terrainVerts);
+    glBindTexture(GL_TEXTURE_2D, m_terrainHeightTexture);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, m_terrain.getGridSide());
+    glTexSubImage2D(GL_TEXTURE_2D, 0, m_dirtyStartCol + 1, m_dirtyStartRow + 1,
+                    m_dirtyEndCol - m_dirtyStartCol, m_dirtyEndRow - m_dirtyStartRow, GL_RED, GL_FLOAT,
+                    m_terrainHeights.data() + m_terrain.getGridIndex(m_dirtyStartRow, m_dirtyStartCol));
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    m_heightsDirty = false;
+}
+
+void Realtime::rebuildTileBounds() {
+    int tilesPerSide = m_terrain.getTilesPerSide();
+    std::vector<TileBounds> tileBounds(tilesPerSide * tilesPerSide);
+    for (int tileIndex = 0; tileIndex < (int)tileBounds.size(); tileIndex++) {
+        tileBounds[tileIndex] = m_terrain.getTileBounds(tileIndex % tilesPerSide, tileIndex / tilesPerSide, m_terrainHeights);
     }
+    m_terrainQuadtree.build(m_terrain, tileBounds);
+}
 
-    m_terrainVbo.bind();
-    glBufferSubData(GL_ARRAY_BUFFER, 0, m_terrainVerts.size() * sizeof(GLfloat),
-                    m_terrainVerts.data());
-    m_terrainVbo.release();
+// Selects LOD patches for the terrain camera and uploads them as instances
+void Realtime::selectTerrainPatches() {
+    glm::mat4 modelView = m_terrainViewMatrix * m_terrainWorldMatrix;
+    Frustum frustum;
+    frustum.setFromMatrix(m_terrainProjMatrix * modelView);
+    m_terrainCameraPosition = glm::vec3(glm::inverse(modelView) * glm::vec4(0, 0, 0, 1));
+
+    m_terrainPatches.clear();
+    m_terrainQuadtree.select(frustum, m_terrainCameraPosition, m_terrainPatches);
+    if (m_terrainPatches.empty()) return;
+
+    m_terrainInstanceVbo.bind();
+    glBufferData(GL_ARRAY_BUFFER, m_terrainPatches.size() * sizeof(glm::vec4),
+                 m_terrainPatches.data(), GL_STREAM_DRAW);
+    m_terrainInstanceVbo.release();
+}
+
+// Draws the selected patches with one instanced call; expects a program built on
+// terrain.vert and the terrain VAO to be bound
+void Realtime::drawTerrainPatches(const TerrainPatchUniformLocations& locs) {
+    if (m_terrainPatches.empty()) return;
+
+    const std::vector<glm::vec2>& morphRanges = m_terrainQuadtree.getMorphRanges();
+    glUniform1i(locs.patchResolution, m_terrainQuadtree.getPatchResolution());
+    glUniform3f(locs.cameraPosition, m_terrainCameraPosition.x, m_terrainCameraPosition.y, m_terrainCameraPosition.z);
+    glUniform2fv(locs.morphRanges, std::min((int)morphRanges.size(), 16), &morphRanges[0].x);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, m_terrainHeightTexture);
+    glUniform1i(locs.heightMap, 1);
+
+    glDrawElementsInstanced(GL_TRIANGLES, m_terrainPatchIndexCount, GL_UNSIGNED_INT, nullptr,
+                            m_terrainPatches.size());
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
 }
 
 // ========== SARYA: TERRAIN OBJECT PLACEMENT SYSTEM - REPLACE THIS CODE AS NEEDED ==========
@@ -330,13 +713,36 @@ void Realtime::placeObjectOnTerrain(float terrainX, float terrainY, PrimitiveTyp
     terrainX = glm::clamp(terrainX, 0.0f, 1.0f);
     terrainY = glm::clamp(terrainY, 0.0f, 1.0f);
 
-    // Get terrain height at this position
-    float terrainHeight = m_terrain.getHeight(terrainX, terrainY);
     // Create object
     TerrainObject obj;
     obj.type = type;
     obj.terrainPosition = glm::vec2(terrainX, terrainY);
     obj.size = size;
+    obj.modelMatrix = objectModelMatrix(type, terrainX, terrainY, size);
+
+    // Random color for variety
+    obj.color = glm::vec4(
+        0.3f + (rand() % 70) / 100.0f,
+        0.3f + (rand() % 70) / 100.0f,
+        0.3f + (rand() % 70) / 100.0f,
+        1.0f
+        );
+
+    if (!createObjectBuffers(obj)) return;
+
+    addTerrainObject(obj);
+
+    // debugging print! shouldn't need it anymore.
+   // std::cout << "Placed " << getObjectTypeName(type) << " at terrain ("
+   //           << terrainX << ", " << terrainY << "), height: " << terrainHeight << std::endl;
+
+    update();
+}
+
+// Sits an object of the given type on the terrain surface at (terrainX, terrainY)
+glm::mat4 Realtime::objectModelMatrix(PrimitiveType type, float terrainX, float terrainY, float size) {
+    // Get terrain height at this position
+    float terrainHeight = m_terrain.getHeight(terrainX, terrainY);
 
     // Build transformation matrix
     glm::mat4 modelMatrix = glm::mat4(1.0f);
@@ -364,23 +770,89 @@ void Realtime::placeObjectOnTerrain(float terrainX, float terrainY, PrimitiveTyp
         break;
     }
 
-    modelMatrix = glm::scale(modelMatrix, glm::vec3(size));
-    obj.modelMatrix = modelMatrix;
+    return glm::scale(modelMatrix, glm::vec3(size));
+}
 
-    // Random color for variety
-    obj.color = glm::vec4(
-        0.3f + (rand() % 70) / 100.0f,
-        0.3f + (rand() % 70) / 100.0f,
-        0.3f + (rand() % 70) / 100.0f,
-        1.0f
-        );
+// Terrain-space box of the object's unit shape ([-0.5, 0.5]^3 before its model matrix)
+void Realtime::objectBounds(const TerrainObject& obj, glm::vec3& boxMin, glm::vec3& boxMax) {
+    glm::vec3 center = glm::vec3(obj.modelMatrix[3]);
+    glm::vec3 extent(0.0f);
+    for (int axis = 0; axis < 3; axis++) {
+        extent += 0.5f * glm::abs(glm::vec3(obj.modelMatrix[axis]));
+    }
+    boxMin = center - extent;
+    boxMax = center + extent;
+}
+
+// Adds an object whose buffers are already created
+void Realtime::addTerrainObject(TerrainObject& obj) {
+    glm::vec3 boxMin, boxMax;
+    objectBounds(obj, boxMin, boxMax);
+    obj.bvhLeaf = m_objectBvh.insert(boxMin, boxMax, m_terrainObjects.size());
+    m_terrainObjects.push_back(obj);
+    m_pickSceneVersion++;
+}
+
+void Realtime::removeTerrainObject(int index) {
+    if (index < 0 || index >= (int)m_terrainObjects.size()) return;
+
+    TerrainObject& obj = m_terrainObjects[index];
+    glDeleteBuffers(1, &obj.vbo);
+    glDeleteVertexArrays(1, &obj.vao);
+    m_objectBvh.remove(obj.bvhLeaf);
+
+    // the last object fills the hole, so its leaf has to learn its new index
+    int last = m_terrainObjects.size() - 1;
+    if (index != last) {
+        m_terrainObjects[index] = m_terrainObjects[last];
+        m_objectBvh.setObject(m_terrainObjects[index].bvhLeaf, index);
+    }
+    m_terrainObjects.pop_back();
+    m_pickSceneVersion++;
+
+    if (m_selectedObject == index) m_selectedObject = -1;
+    else if (m_selectedObject == last) m_selectedObject = index;
+    m_hoveredObject = -1;
+    update();
+}
+
+void Realtime::moveTerrainObject(int index, float terrainX, float terrainY) {
+    if (index < 0 || index >= (int)m_terrainObjects.size()) return;
+
+    TerrainObject& obj = m_terrainObjects[index];
+    obj.terrainPosition = glm::vec2(glm::clamp(terrainX, 0.0f, 1.0f), glm::clamp(terrainY, 0.0f, 1.0f));
+    obj.modelMatrix = objectModelMatrix(obj.type, obj.terrainPosition.x, obj.terrainPosition.y, obj.size);
+
+    glm::vec3 boxMin, boxMax;
+    objectBounds(obj, boxMin, boxMax);
+    m_objectBvh.move(obj.bvhLeaf, boxMin, boxMax);
+    m_pickSceneVersion++;
+    update();
+}
+
+// Nearest object hit by the terrain-space ray within t; lowers t to the hit. Candidates
+// come from the BVH, and only their own triangles are tested, a packet at a time, in
+// the object's space.
+int Realtime::pickTerrainObject(const glm::vec3& origin, const glm::vec3& dir, float& t) {
+    return m_objectBvh.raycast(origin, dir, t, [&](int index, float& tHit) {
+        const TerrainObject& obj = m_terrainObjects[index];
+        glm::mat4 modelInverse = glm::inverse(obj.modelMatrix);
+        // affine, so t measured along the local ray matches t along the terrain-space one
+        glm::vec3 localOrigin = glm::vec3(modelInverse * glm::vec4(origin, 1.0f));
+        glm::vec3 localDir = glm::vec3(modelInverse * glm::vec4(dir, 0.0f));
+
+        return rayIntersectsPackets(localOrigin, localDir, getTrianglePacketsForType(obj.type), tHit) != -1;
+    });
+}
 
+// Creates the VBO/VAO for an object from its type's shape data
+bool Realtime::createObjectBuffers(TerrainObject& obj) {
     // Get appropriate vertex data based on type
-    std::vector<float> vertexData = getVertexDataForType(type);
+    std::vector<float> vertexData = getVertexDataForType(obj.type);
 
     if (vertexData.empty()) {
         std::cerr << "Failed to get vertex data for object type" << std::endl;
-        return;
+        return false;
     }
 
     // Create OpenGL buffers
@@ -406,17 +878,11 @@ void Realtime::placeObjectOnTerrain(float terrainX, float terrainY, PrimitiveTyp
     obj.vbo = vbo;
     obj.vao = vao;
     obj.vertexCount = vertexData.size() / 6;
-
-    m_terrainObjects.push_back(obj);
-
-    // debugging print! shouldn't need it anymore.
-   // std::cout << "Placed " << getObjectTypeName(type) << " at terrain ("
-   //           << terrainX << ", " << terrainY << "), height: " << terrainHeight << std::endl;
-
-    update();
+    return true;
 }
 
-std::vector<float> Realtime::getVertexDataForType(PrimitiveType type) {
+const std::vector<float>& Realtime::getVertexDataForType(PrimitiveType type) {
+    static const std::vector<float> empty;
     switch(type) {
     case PrimitiveType::PRIMITIVE_CUBE:
         return m_cube_data;
@@ -427,7 +893,23 @@ std::vector<float> Realtime::getVertexDataForType(PrimitiveType type) {
     case PrimitiveType::PRIMITIVE_CYLINDER:
         return m_cylinder_data;
     default:
-        return std::vector<float>();
+        return empty;
+    }
+}
+
+const std::vector<TrianglePacket>& Realtime::getTrianglePacketsForType(PrimitiveType type) {
+    static const std::vector<TrianglePacket> empty;
+    switch(type) {
+    case PrimitiveType::PRIMITIVE_CUBE:
+        return m_cube_packets;
+    case PrimitiveType::PRIMITIVE_SPHERE:
+        return m_sphere_packets;
+    case PrimitiveType::PRIMITIVE_CONE:
+        return m_cone_packets;
+    case PrimitiveType::PRIMITIVE_CYLINDER:
+        return m_cylinder_packets;
+    default:
+        return empty;
     }
 }
 
@@ -447,10 +929,80 @@ void Realtime::clearTerrainObjects() {
         glDeleteVertexArrays(1, &obj.vao);
     }
     m_terrainObjects.clear();
+    m_objectBvh.clear();
+    m_pickSceneVersion++;
+    m_hoveredObject = -1;
+    m_selectedObject = -1;
     update();
     std::cout << "Cleared all terrain objects" << std::endl;
 }
 
+// ========== GARDEN FILES ==========
+
+bool Realtime::saveGarden(const std::string& filePath) {
+    std::vector<GardenObject> objects;
+    objects.reserve(m_terrainObjects.size());
+    for (const TerrainObject& obj : m_terrainObjects) {
+        GardenObject record;
+        record.type = (int32_t)obj.type;
+        std::memcpy(record.terrainPosition, &obj.terrainPosition[0], sizeof(record.terrainPosition));
+        record.size = obj.size;
+        std::memcpy(record.color, &obj.color[0], sizeof(record.color));
+        std::memcpy(record.modelMatrix, &obj.modelMatrix[0][0], sizeof(record.modelMatrix));
+        objects.push_back(record);
+    }
+
+    if (!GardenFile::save(filePath, m_terrain, objects)) return false;
+    std::cout << "Saved garden to " << filePath << std::endl;
+    return true;
+}
+
+// The file is mapped and its height layers copied straight into place; no noise is
+// recomputed.
+bool Realtime::loadGarden(const std::string& filePath) {
+    GardenFile garden;
+    if (!garden.open(filePath)) return false;
+
+    const GardenFileHeader& header = garden.header();
+    if ((int)header.resolution != m_terrain.getResolution()) {
+        std::cerr << "Garden resolution " << header.resolution << " does not match the terrain ("
+                  << m_terrain.getResolution() << ")" << std::endl;
+        return false;
+    }
+
+    makeCurrent();
+
+    m_sandRelaxer.clear();
+    m_strokeSettling = false;
+    m_sculptJournal.clear();
+    m_terrain.restoreHeightLayers(header.seed, garden.noiseParams(),
+                                  garden.baseHeights(), garden.heightDeltas());
+
+    int gridSide = m_terrain.getGridSide();
+    m_terrain.readHeights(-1, gridSide - 1, -1, gridSide - 1, m_terrainHeights);
+    m_heightPyramid.build(m_terrainHeights, m_terrain.getResolution());
+    rebuildTileBounds();
+    markHeightsDirty(-1, gridSide - 1, -1, gridSide - 1);
+    uploadDirtyHeights();
+
+    clearTerrainObjects();
+    const GardenObject* records = garden.objects();
+    for (uint32_t i = 0; i < header.objectCount; i++) {
+        TerrainObject obj;
+        obj.type = (PrimitiveType)records[i].type;
+        std::memcpy(&obj.terrainPosition[0], records[i].terrainPosition, sizeof(records[i].terrainPosition));
+        obj.size = records[i].size;
+        std::memcpy(&obj.color[0], records[i].color, sizeof(records[i].color));
+        std::memcpy(&obj.modelMatrix[0][0], records[i].modelMatrix, sizeof(records[i].modelMatrix));
+        if (createObjectBuffers(obj)) addTerrainObject(obj);
+    }
+
+    doneCurrent();
+    update();
+    std::cout << "Loaded garden from " << filePath << std::endl;
+    return true;
+}
+
 GLuint Realtime::typeInterpretVao(PrimitiveType type) {
     switch (type) {
     case PrimitiveType::PRIMITIVE_CONE:
@@ -543,19 +1095,33 @@ void Realtime::paintGL() {
     if (m_showTerrain) {
         glEnable(GL_DEPTH_TEST);
 
-        m_terrainProgram->bind();
-        m_terrainProgram->setUniformValue(m_terrainProjMatrixLoc, m_terrainProj);
-        m_terrainProgram->setUniformValue(m_terrainMvMatrixLoc, m_terrainCamera * m_terrainWorld);
-        m_terrainProgram->setUniformValue(m_terrainWireshadeLoc, m_terrain.m_wireshade);
-
-        int res = m_terrain.getResolution();
+        processPendingCursor();
+        applyRakeStamps();
+        settleSand();
+        uploadDirtyHeights();
 
-        m_terrainVao.bind();
-        glPolygonMode(GL_FRONT_AND_BACK, m_terrain.m_wireshade ? GL_LINE : GL_FILL);
-        glDrawArrays(GL_TRIANGLES, 0, res * res * 6);
-        m_terrainVao.release();
-
-        m_terrainProgram->release();
+        if (m_tessellateTerrain) {
+            drawTessellatedTerrain();
+        }
+        else {
+            m_terrainProgram->bind();
+            m_terrainProgram->setUniformValue(m_terrainProjMatrixLoc, m_terrainProj);
+            m_terrainProgram->setUniformValue(m_terrainMvMatrixLoc, m_terrainCamera * m_terrainWorld);
+            m_terrainProgram->setUniformValue(m_terrainWireshadeLoc, m_terrain.m_wireshade);
+            m_terrainProgram->setUniformValue(m_terrainGridResolutionLoc, m_terrain.getResolution());
+            glm::vec3 sandColor = m_terrain.getSandColor();
+            m_terrainProgram->setUniformValue(m_terrainSandColorLoc, sandColor.r, sandColor.g, sandColor.b);
+            m_terrainProgram->setUniformValue(m_terrainColorHeightMinLoc, m_terrain.getColorHeightMin());
+            m_terrainProgram->setUniformValue(m_terrainColorHeightMaxLoc, m_terrain.getColorHeightMax());
+
+            m_terrainVao.bind();
+            glPolygonMode(GL_FRONT_AND_BACK, m_terrain.m_wireshade ? GL_LINE : GL_FILL);
+            selectTerrainPatches();
+            drawTerrainPatches(m_terrainPatchLocs);
+            m_terrainVao.release();
+
+            m_terrainProgram->release();
+        }
     }
 
     // ========== SARYA: OBJECTS ON SAND RENDERING - UPDATE SHADER IF NECESSARY ==========
@@ -602,9 +1168,14 @@ void Realtime::paintGL() {
     }
 
     // SARYA - RENDER TERRAIN OBJS - CHANGE IF NEEDED
-    for (const TerrainObject& obj : m_terrainObjects) {
+    for (size_t i = 0; i < m_terrainObjects.size(); i++) {
+        const TerrainObject& obj = m_terrainObjects[i];
         glBindVertexArray(obj.vao);
 
+        // hover feedback from the GPU pick; the selected object is tinted gold
+        glm::vec4 color = (int)i == m_hoveredObject ? glm::min(obj.color * 1.3f + 0.15f, glm::vec4(1.0f)) : obj.color;
+        if ((int)i == m_selectedObject) color = glm::mix(color, glm::vec4(1.0f, 0.8f, 0.2f, 1.0f), 0.6f);
+
         glm::mat4 fullModelMatrix = m_terrainWorldMatrix * obj.modelMatrix;
 
         if (m_uniformLocs.model != -1) glUniformMatrix4fv(m_uniformLocs.model, 1, GL_FALSE, &fullModelMatrix[0][0]);
@@ -615,8 +1186,8 @@ void Realtime::paintGL() {
         glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(fullModelMatrix)));
         if (m_uniformLocs.ictm != -1) glUniformMatrix3fv(m_uniformLocs.ictm, 1, GL_FALSE, &normalMatrix[0][0]);
 
-        if (m_uniformLocs.cAmbient != -1) glUniform4fv(m_uniformLocs.cAmbient, 1, &obj.color[0]);
-        if (m_uniformLocs.cDiffuse != -1) glUniform4fv(m_uniformLocs.cDiffuse, 1, &obj.color[0]);
+        if (m_uniformLocs.cAmbient != -1) glUniform4fv(m_uniformLocs.cAmbient, 1, &color[0]);
+        if (m_uniformLocs.cDiffuse != -1) glUniform4fv(m_uniformLocs.cDiffuse, 1, &color[0]);
         if (m_uniformLocs.cSpecular != -1) glUniform4f(m_uniformLocs.cSpecular, 0.5f, 0.5f, 0.5f, 1.0f);
         if (m_uniformLocs.shininess != -1) glUniform1f(m_uniformLocs.shininess, 32.0f);
         if (m_uniformLocs.cReflective != -1) glUniform4f(m_uniformLocs.cReflective, 0.0f, 0.0f, 0.0f, 0.0f);
@@ -626,6 +1197,15 @@ void Realtime::paintGL() {
     }
 
     glUseProgram(0);
+
+    if (m_gpuPicking && m_showTerrain) {
+        // a skipped pass stays requested; pollGpuPick() keeps frames coming while
+        // the readbacks that block it are in flight
+        if (m_pickRequested && renderPickPass()) {
+            m_pickRequested = false;
+        }
+        pollGpuPick();
+    }
 }
 
 void Realtime::resizeGL(int w, int h) {
@@ -717,6 +1297,25 @@ void Realtime::keyPressEvent(QKeyEvent *event) {
         update();
     }
 
+    // Toggle the tessellated terrain path
+    if (event->key() == Qt::Key_L) {
+        if (!m_tessellationSupported) {
+            std::cout << "Terrain tessellation is not supported by this GL context" << std::endl;
+        } else {
+            m_tessellateTerrain = !m_tessellateTerrain;
+            std::cout << "Terrain tessellation " << (m_tessellateTerrain ? "enabled" : "disabled") << std::endl;
+            update();
+        }
+    }
+
+    // Toggle GPU hover picking
+    if (event->key() == Qt::Key_H) {
+        m_gpuPicking = !m_gpuPicking;
+        m_hoveredObject = -1;
+        std::cout << "Hover picking " << (m_gpuPicking ? "enabled" : "disabled") << std::endl;
+        update();
+    }
+
     // Toggle object placement mode
     if (event->key() == Qt::Key_C) {
         m_placeObjectMode = !m_placeObjectMode;
@@ -749,6 +1348,21 @@ void Realtime::keyPressEvent(QKeyEvent *event) {
     if (event->key() == Qt::Key_X) {
         clearTerrainObjects();
     }
+
+    // Delete the selected object
+    if ((event->key() == Qt::Key_Delete || event->key() == Qt::Key_Backspace) && m_selectedObject != -1) {
+        removeTerrainObject(m_selectedObject);
+    }
+
+    // Undo/redo sculpting
+    if (event->modifiers().testFlag(Qt::ControlModifier)) {
+        if (event->key() == Qt::Key_Z && !event->modifiers().testFlag(Qt::ShiftModifier)) {
+            undoSculpt();
+        }
+        else if (event->key() == Qt::Key_Y || event->key() == Qt::Key_Z) {
+            redoSculpt();
+        }
+    }
 }
 
 void Realtime::keyReleaseEvent(QKeyEvent *event) {
@@ -765,10 +1379,45 @@ void Realtime::mousePressEvent(QMouseEvent *event) {
     if (m_showTerrain && event->buttons().testFlag(Qt::LeftButton)) {
         m_prevMousePosQt = event->pos();
 
-        std::optional<glm::vec3> planeInt = mouse::mouse_click_callback(
-            1, 1, event->pos().x(), event->pos().y(),
-            m_w, m_h, m_terrainProjMatrix, m_terrainViewMatrix, m_terrainVerts,
-            m_terrain.getResolution(), m_terrainWorldMatrix);
+        std::optional<glm::vec3> planeInt;
+        int picked = -1;
+
+        // with hover picking on, the pick that landed for this pixel already says what
+        // was hit, and where; placing needs the terrain behind any object, though
+        GpuPickResult gpuPick;
+        if (currentGpuPick(glm::ivec2(event->pos().x(), event->pos().y()), gpuPick) &&
+            !(m_placeObjectMode && gpuPick.id >= GpuPicker::kFirstObjectId)) {
+            if (gpuPick.id == GpuPicker::kTerrainId) planeInt = gpuPick.worldPos;
+            else if (gpuPick.id >= GpuPicker::kFirstObjectId) picked = gpuPick.id - GpuPicker::kFirstObjectId;
+        }
+        else {
+            planeInt = mouse::mouse_click_callback(
+                1, 1, event->pos().x(), event->pos().y(),
+                m_w, m_h, m_terrainProjMatrix, m_terrainViewMatrix, m_terrainHeights,
+                m_heightPyramid, m_terrainWorldMatrix);
+
+            // an object in front of the terrain takes the click
+            if (!m_placeObjectMode && !m_terrainObjects.empty()) {
+                glm::vec3 origin, dir;
+                mouse::terrainRay(event->pos().x(), event->pos().y(), m_w, m_h,
+                                  m_terrainProjMatrix, m_terrainViewMatrix, m_terrainWorldMatrix, origin, dir);
+                float t = INFINITY;
+                if (planeInt.has_value()) {
+                    glm::vec3 terrainHit = glm::vec3(glm::inverse(m_terrainWorldMatrix) * glm::vec4(planeInt.value(), 1.0f));
+                    t = glm::dot(terrainHit - origin, dir) / glm::dot(dir, dir);
+                }
+                picked = pickTerrainObject(origin, dir, t);
+            }
+        }
+
+        // select the object and drag it around
+        if (picked != -1) {
+            m_selectedObject = picked;
+            m_draggingObject = true;
+            m_intersected = 2;
+            update();
+            return;
+        }
 
         if (planeInt.has_value()) {
             m_intersected = 1;
@@ -782,34 +1431,15 @@ void Realtime::mousePressEvent(QMouseEvent *event) {
             }
             // Terrain sculpting mode
             else {
-                float craterDepth = 0.005f;
-                float craterRadius = 0.01f;
-
-                std::vector<std::pair<float, float>> offsets = {
-                    {0.075f, 0.0f},
-                    {-0.075f, 0.0f},
-                    {0.025f, 0.00f},
-                    {-0.025f, 0.0f}
-                };
-
-                std::unordered_set<int> allAffectedTiles;
-
-                for (const auto& offset : offsets) {
-                    float x = m_hitPoint.x + offset.first;
-                    float y = m_hitPoint.y + offset.second;
-
-                    if (x >= 0.0f && x <= 1.0f && y >= 0.0f && y <= 1.0f) {
-                        m_terrain.divot(x, y, craterDepth, craterRadius);
-                        std::vector<int> tiles = m_terrain.getAffectedTiles(x, y, craterRadius);
-                        allAffectedTiles.insert(tiles.begin(), tiles.end());
-                    }
-                }
-
-                float totalRadius = craterRadius + 0.05f;
-                std::vector<int> totalTiles = m_terrain.getAffectedTiles(m_hitPoint.x, m_hitPoint.y, totalRadius);
-                allAffectedTiles.insert(totalTiles.begin(), totalTiles.end());
-
-                updateAffectedTiles(allAffectedTiles);
+                // sand from the last stroke may still be settling; close that entry, so
+                // this stroke starts an undo step of its own
+                m_sculptJournal.endStroke();
+                m_strokeSettling = false;
+
+                m_selectedObject = -1;
+                m_raking = true;
+                m_rake.beginStroke(glm::vec2(m_hitPoint));
+                update();
             }
         }
         else {
@@ -818,9 +1448,120 @@ void Realtime::mousePressEvent(QMouseEvent *event) {
     }
 }
 
+// Cursor points picked per frame along a sculpt stroke, and the most kept between frames
+static constexpr int kMaxStrokePicksPerFrame = 16;
+static constexpr size_t kMaxPendingCursorPoints = 256;
+
+// Picks along the cursor path recorded since the last frame: the latest point for an
+// object drag, or up to kMaxStrokePicksPerFrame points spread along a sculpt stroke.
+// The rake interpolates between them, so the per-frame cost stays bounded.
+void Realtime::processPendingCursor() {
+    if (m_pendingCursorPath.empty()) return;
+
+    if (m_mouseDown && m_draggingObject) {
+        glm::vec3 terrainPoint;
+        if (pickTerrainPoint(m_pendingCursorPath.back(), terrainPoint)) {
+            moveTerrainObject(m_selectedObject, terrainPoint.x, terrainPoint.y);
+        }
+    }
+    else if (m_mouseDown && m_intersected == 1 && !m_placeObjectMode) {
+        int count = m_pendingCursorPath.size();
+        int picks = std::min(count, kMaxStrokePicksPerFrame);
+        for (int i = 0; i < picks; i++) {
+            if (!pickTerrainPoint(m_pendingCursorPath[(i + 1) * count / picks - 1], m_hitPoint)) {
+                m_intersected = 3;
+                break;
+            }
+            // the rake resamples the path itself; stamps are applied in paintGL
+            m_rake.moveTo(glm::vec2(m_hitPoint));
+        }
+    }
+    m_pendingCursorPath.clear();
+}
+
+// The terrain point (terrain space) under a cursor position, if the ray hits the terrain
+bool Realtime::pickTerrainPoint(glm::vec2 cursor, glm::vec3& terrainPoint) {
+    std::optional<glm::vec3> planeInt = mouse::mouse_click_callback(
+        1, 1, cursor.x, cursor.y,
+        m_w, m_h, m_terrainProjMatrix, m_terrainViewMatrix, m_terrainHeights,
+        m_heightPyramid, m_terrainWorldMatrix);
+    if (!planeInt.has_value()) return false;
+
+    terrainPoint = glm::vec3(glm::inverse(m_terrainWorldMatrix) * glm::vec4(planeInt.value(), 1.0f));
+    return true;
+}
+
+// Presses this frame's rake stamps into the sand. The stamps are merged into one
+// dirty rectangle, so each frame journals and uploads its tiles exactly once.
+void Realtime::applyRakeStamps() {
+    glm::vec2 minCorner, maxCorner;
+    if (!m_rake.getPendingBounds(minCorner, maxCorner)) return;
+
+    std::vector<int> tiles = m_terrain.getTilesInRect(minCorner.x, minCorner.y, maxCorner.x, maxCorner.y);
+    m_sculptJournal.captureTiles(tiles);
+    m_rake.applyPending(m_terrain);
+    m_sandRelaxer.activate(tiles);
+    updateAffectedTiles(std::unordered_set<int>(tiles.begin(), tiles.end()));
+}
+
+// Lets recently sculpted sand slump towards the angle of repose, within the frame
+// budget. After a stroke is released, the settling is journaled as its own undo
+// entry, closed once the sand rests or the next stroke begins.
+void Realtime::settleSand() {
+    if (m_sandRelaxer.isActive()) {
+        m_sculptJournal.captureTiles(m_sandRelaxer.getActiveTiles());
+
+        std::unordered_set<int> tiles;
+        m_sandRelaxer.step(tiles);
+        updateAffectedTiles(tiles);
+
+        // keep frames coming until the sand comes to rest
+        if (m_sandRelaxer.isActive()) update();
+    }
+
+    if (m_strokeSettling && !m_sandRelaxer.isActive()) {
+        m_sculptJournal.endStroke();
+        m_strokeSettling = false;
+    }
+}
+
+// Undo/redo only re-upload the tiles recorded with the stroke, through the same
+// height texture path sculpting uses
+void Realtime::undoSculpt() {
+    m_sandRelaxer.clear();
+    m_strokeSettling = false;
+
+    std::unordered_set<int> tiles;
+    if (m_sculptJournal.undo(tiles)) {
+        updateAffectedTiles(tiles);
+        update();
+    }
+}
+
+void Realtime::redoSculpt() {
+    m_sandRelaxer.clear();
+    m_strokeSettling = false;
+
+    std::unordered_set<int> tiles;
+    if (m_sculptJournal.redo(tiles)) {
+        updateAffectedTiles(tiles);
+        update();
+    }
+}
+
 void Realtime::mouseReleaseEvent(QMouseEvent *event) {
     if (!event->buttons().testFlag(Qt::LeftButton)) {
+        // finish the path recorded since the last frame before the stroke ends
+        processPendingCursor();
         m_mouseDown = false;
+        applyRakeStamps();
+        if (m_raking) {
+            m_sculptJournal.endStroke();
+            m_raking = false;
+        }
+        m_strokeSettling = true;
+        m_draggingObject = false;
+        update();
     }
     m_intersected = 0;
 }
@@ -838,58 +1579,22 @@ glm::mat3 rotMat(glm::vec3 &u, float angle) {
 }
 
 void Realtime::mouseMoveEvent(QMouseEvent *event) {
-    // Terrain sculpting when dragging
-    if (m_mouseDown && m_showTerrain && m_intersected == 1 && !m_placeObjectMode) {
-        std::optional<glm::vec3> planeInt = mouse::mouse_click_callback(
-            1, 1, event->pos().x(), event->pos().y(),
-            m_w, m_h, m_terrainProjMatrix, m_terrainViewMatrix, m_terrainVerts,
-            m_terrain.getResolution(), m_terrainWorldMatrix);
-
-        if (planeInt.has_value()) {
-            glm::vec3 hitpoint = planeInt.value();
-            glm::mat4 worldInverse = glm::inverse(m_terrainWorldMatrix);
-            glm::vec3 newHitPoint = glm::vec3(worldInverse * glm::vec4(hitpoint, 1.0f));
-
-            float dx = newHitPoint.x - m_hitPoint.x;
-            float dy = newHitPoint.y - m_hitPoint.y;
-            float distSq = dx * dx + dy * dy;
-
-            if (distSq > 0.00025f) {
-                m_hitPoint = newHitPoint;
-
-                float craterDepth = 0.005f;
-                float craterRadius = 0.01f;
-
-                std::vector<std::pair<float, float>> offsets = {
-                    {0.075f, 0.0f},
-                    {-0.075f, 0.0f},
-                    {0.025f, 0.00f},
-                    {-0.025f, 0.0f}
-                };
-
-                std::unordered_set<int> allAffectedTiles;
-
-                for (const auto& offset : offsets) {
-                    float x = m_hitPoint.x + offset.first;
-                    float y = m_hitPoint.y + offset.second;
-
-                    if (x >= 0.0f && x <= 1.0f && y >= 0.0f && y <= 1.0f) {
-                        m_terrain.divot(x, y, craterDepth, craterRadius);
-                        std::vector<int> tiles = m_terrain.getAffectedTiles(x, y, craterRadius);
-                        allAffectedTiles.insert(tiles.begin(), tiles.end());
-                    }
-                }
-
-                float totalRadius = craterRadius + 0.05f;
-                std::vector<int> totalTiles = m_terrain.getAffectedTiles(m_hitPoint.x, m_hitPoint.y, totalRadius);
-                allAffectedTiles.insert(totalTiles.begin(), totalTiles.end());
+    if (m_gpuPicking) {
+        m_pickCursor = glm::ivec2(event->pos().x(), event->pos().y());
+        m_pickRequested = true;
+        update();
+    }
 
-                updateAffectedTiles(allAffectedTiles);
-            }
-        }
-        else {
-            m_intersected = 3;
+    // Dragging the selected object, or sculpting: only record the cursor here, since
+    // mice can report far more often than frames are drawn
+    if (m_mouseDown && m_showTerrain && (m_draggingObject || (m_intersected == 1 && !m_placeObjectMode))) {
+        glm::vec2 cursor(event->pos().x(), event->pos().y());
+        if (m_pendingCursorPath.empty() || m_pendingCursorPath.back() != cursor) {
+            // if frames stall, keep the path bounded by moving its end instead
+            if (m_pendingCursorPath.size() < kMaxPendingCursorPoints) m_pendingCursorPath.push_back(cursor);
+            else m_pendingCursorPath.back() = cursor;
         }
+        update();
     }
     // Terrain camera rotation
     else if (m_mouseDown && m_showTerrain && m_intersected == 0) {
@@ -22,7 +22,16 @@
 #include "utils/cube.h"
 #include "utils/cylinder.h"
 #include "utils/shaderloader.h"
+#include "utils/frustum.h"
 #include "terrain.h"
+#include "sculptjournal.h"
+#include "rakebrush.h"
+#include "sandrelaxer.h"
+#include "terrainquadtree.h"
+#include "heightpyramid.h"
+#include "gpupicker.h"
+#include "objectbvh.h"
+#include "utils/raytriangle.h"
 #include "skybox.h"
 
 
@@ -49,6 +58,7 @@ public:
         GLuint vbo;                   // Vertex buffer object
         GLuint vao;                   // Vertex array object
         GLsizei vertexCount;          // Number of vertices
+        int bvhLeaf;                  // Leaf in m_objectBvh
     };
 
     std::vector<TerrainObject> m_terrainObjects;
@@ -59,6 +69,13 @@ public:
 
     // Clear all terrain objects
     void clearTerrainObjects();
+    // Delete or move a single object; indices past a removed one may change
+    void removeTerrainObject(int index);
+    void moveTerrainObject(int index, float terrainX, float terrainY);
+
+    // Save/load the sculpted heights, noise settings and objects as a binary garden file
+    bool saveGarden(const std::string& filePath);
+    bool loadGarden(const std::string& filePath);
 
 public slots:
     void tick(QTimerEvent* event);
@@ -108,6 +125,12 @@ private:
     std::vector<float> m_cube_data;
     std::vector<float> m_cylinder_data;
 
+    // Shape triangles packed for ray picking
+    std::vector<TrianglePacket> m_sphere_packets;
+    std::vector<TrianglePacket> m_cone_packets;
+    std::vector<TrianglePacket> m_cube_packets;
+    std::vector<TrianglePacket> m_cylinder_packets;
+
     // Setup helpers
     void bindData(std::vector<float> &shapeData, GLuint &vbo);
     void setUpBindings(std::vector<float> &shapeData, GLuint &vbo, GLuint &vao);
@@ -180,14 +203,90 @@ private:
     // ========== TERRAIN VARIABLES ==========
     QOpenGLShaderProgram *m_terrainProgram = nullptr;
     QOpenGLVertexArrayObject m_terrainVao;
-    QOpenGLBuffer m_terrainVbo;
+    QOpenGLBuffer m_terrainIbo = QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);  // LOD patch indices
+    QOpenGLBuffer m_terrainInstanceVbo;     // selected LOD patches, refilled every frame
+    GLuint m_terrainHeightTexture = 0;      // R32F heights in grid layout, displaced in terrain.vert
+
+    // Optional tessellated path (L): one patch per tile, subdivided by projected edge length
+    QOpenGLShaderProgram *m_terrainTessProgram = nullptr;
+    QOpenGLVertexArrayObject m_terrainTessVao;
+    QOpenGLBuffer m_terrainTessVbo;         // four grid corners per tile, in tile order
+    bool m_tessellationSupported = false;
+    bool m_tessellateTerrain = false;
+    std::vector<int> m_visibleTiles;
+    std::vector<GLint> m_tilePatchFirsts;
+    std::vector<GLsizei> m_tilePatchCounts;
+
+    struct TerrainTessUniformLocations {
+        int projMatrix;
+        int mvMatrix;
+        int wireshade;
+        int gridResolution;
+        int heightMap;
+        int viewportSize;
+        int pixelsPerSegment;
+        int maxTessLevel;
+        int sandColor;
+        int colorHeightMin;
+        int colorHeightMax;
+    } m_terrainTessLocs;
 
     Terrain m_terrain;
-    std::vector<GLfloat> m_terrainVerts;
+    SculptJournal m_sculptJournal{m_terrain};
+    RakeBrush m_rake;
+    SandRelaxer m_sandRelaxer{m_terrain};
+    bool m_raking = false;          // a rake stroke is in progress
+    bool m_strokeSettling = false;  // released, but its sand is still relaxing into its own undo entry
+
+    // CPU copy of the height texture, for picking and tile bounds. Sculpting refreshes
+    // it right away; the texels it changed are uploaded by the next paintGL.
+    std::vector<float> m_terrainHeights;
+    HeightPyramid m_heightPyramid;  // max heights over m_terrainHeights, for picking
+    bool m_heightsDirty = false;
+    int m_dirtyStartRow, m_dirtyEndRow, m_dirtyStartCol, m_dirtyEndCol;  // grid samples, end exclusive
+
+    // LOD selection over the tiles, culled with per-tile height bounds
+    TerrainQuadtree m_terrainQuadtree;
+    std::vector<glm::vec4> m_terrainPatches;
+    glm::vec3 m_terrainCameraPosition;  // terrain space, as of the last selection
+    GLsizei m_terrainPatchIndexCount = 0;
 
     int m_terrainProjMatrixLoc;
     int m_terrainMvMatrixLoc;
     int m_terrainWireshadeLoc;
+    int m_terrainGridResolutionLoc;
+    int m_terrainSandColorLoc;
+    int m_terrainColorHeightMinLoc;
+    int m_terrainColorHeightMaxLoc;
+
+    // uniforms of terrain.vert's LOD patches, in each program that uses it
+    struct TerrainPatchUniformLocations {
+        int heightMap;
+        int patchResolution;
+        int cameraPosition;
+        int morphRanges;
+    } m_terrainPatchLocs;
+
+    // GPU hover picking (H): IDs and depth under the cursor, read back asynchronously
+    GpuPicker m_gpuPicker;
+    QOpenGLShaderProgram *m_terrainPickProgram = nullptr;
+    QOpenGLShaderProgram *m_objectPickProgram = nullptr;
+    TerrainPatchUniformLocations m_terrainPickPatchLocs;
+    struct PickUniformLocations {
+        int terrainProjMatrix;
+        int terrainMvMatrix;
+        int terrainGridResolution;
+        int terrainPickId;
+        int objectMvp;
+        int objectPickId;
+    } m_pickLocs;
+    bool m_gpuPicking = false;
+    bool m_pickRequested = false;   // the cursor moved since the last pick pass
+    glm::ivec2 m_pickCursor;        // widget coordinates
+    int m_hoveredObject = -1;
+    uint64_t m_pickSceneVersion = 0;    // bumped whenever the camera, heights or objects change
+    GpuPickResult m_lastPick;       // latest landed pick; current while its tag is m_pickSceneVersion
+    bool m_hasLastPick = false;
 
     QMatrix4x4 m_terrainWorld;
     QMatrix4x4 m_terrainCamera;
@@ -209,6 +308,13 @@ private:
 
     bool m_showTerrain;
     bool m_placeObjectMode = false;
+    ObjectBvh m_objectBvh;          // terrain-space boxes of m_terrainObjects
+    int m_selectedObject = -1;
+    bool m_draggingObject = false;
+
+    // Cursor positions (widget coordinates) of an object drag or sculpt stroke since the
+    // last frame; mouseMoveEvent only records them, processPendingCursor() acts on them
+    std::vector<glm::vec2> m_pendingCursorPath;
     PrimitiveType m_currentObjectType = PrimitiveType::PRIMITIVE_CUBE;
 
     // Terrain methods
@@ -216,9 +322,34 @@ private:
     void rebuildTerrainMatrices();
     void updateAffectedTiles(const std::unordered_set<int>& affectedTiles);
     void updateAffectedTiles(float x, float y, float radius);
+    void markHeightsDirty(int startRow, int endRow, int startCol, int endCol);
+    void uploadDirtyHeights();
+    void rebuildTileBounds();
+    void updateTerrainLodRange();
+    void selectTerrainPatches();
+    void drawTerrainPatches(const TerrainPatchUniformLocations& locs);
+    void initializeGpuPicking();
+    bool renderPickPass();
+    void pollGpuPick();
+    glm::ivec2 pickPixel(glm::ivec2 cursor);
+    bool currentGpuPick(glm::ivec2 cursor, GpuPickResult& result);
+    void initializeTessellatedTerrain();
+    void drawTessellatedTerrain();
+    void processPendingCursor();
+    bool pickTerrainPoint(glm::vec2 cursor, glm::vec3& terrainPoint);
+    void applyRakeStamps();
+    void settleSand();
+    void undoSculpt();
+    void redoSculpt();
 
     // Helper methods for terrain object system
-    std::vector<float> getVertexDataForType(PrimitiveType type);
+    const std::vector<float>& getVertexDataForType(PrimitiveType type);
+    const std::vector<TrianglePacket>& getTrianglePacketsForType(PrimitiveType type);
+    glm::mat4 objectModelMatrix(PrimitiveType type, float terrainX, float terrainY, float size);
+    void objectBounds(const TerrainObject& obj, glm::vec3& boxMin, glm::vec3& boxMax);
+    void addTerrainObject(TerrainObject& obj);
+    int pickTerrainObject(const glm::vec3& origin, const glm::vec3& dir, float& t);
+    bool createObjectBuffers(TerrainObject& obj);
     std::string getObjectTypeName(PrimitiveType type);
 
 
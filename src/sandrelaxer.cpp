@@ -0,0 +1,71 @@
+#include "sandrelaxer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+SandRelaxer::SandRelaxer(Terrain& terrain)
+    : m_terrain(terrain),
+      m_isActive(terrain.getTilesPerSide() * terrain.getTilesPerSide(), 0)
+{
+}
+
+void SandRelaxer::clear() {
+    std::fill(m_isActive.begin(), m_isActive.end(), 0);
+    m_activeTiles.clear();
+}
+
+void SandRelaxer::activate(const std::vector<int>& tiles) {
+    for (int tileIndex : tiles) activateAround(tileIndex, m_isActive, true);
+}
+
+void SandRelaxer::activateAround(int tileIndex, const std::vector<char>& wasActive, bool admitNew) {
+    int tilesPerSide = m_terrain.getTilesPerSide();
+    int tx = tileIndex % tilesPerSide;
+    int ty = tileIndex / tilesPerSide;
+    static const int offsets[5][2] = {{0, 0}, {-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    for (const auto& offset : offsets) {
+        int nx = tx + offset[0];
+        int ny = ty + offset[1];
+        if (nx < 0 || ny < 0 || nx >= tilesPerSide || ny >= tilesPerSide) continue;
+
+        int neighbour = ny * tilesPerSide + nx;
+        if (m_isActive[neighbour] || (!admitNew && !wasActive[neighbour])) continue;
+        m_isActive[neighbour] = 1;
+        m_activeTiles.push_back(neighbour);
+    }
+}
+
+void SandRelaxer::retainAround(const std::vector<int>& movedTiles, bool admitNew) {
+    std::vector<char> wasActive(m_isActive.size(), 0);
+    wasActive.swap(m_isActive);
+    m_activeTiles.clear();
+    for (int tileIndex : movedTiles) activateAround(tileIndex, wasActive, admitNew);
+}
+
+void SandRelaxer::step(std::unordered_set<int>& changedTiles) {
+    if (m_activeTiles.empty()) return;
+
+    // height difference between neighbouring samples at the angle of repose
+    float maxStep = std::tan(glm::radians(m_params.reposeAngle)) / m_terrain.getResolution();
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int> movedTiles;
+    for (int pass = 0; pass < m_params.maxPassesPerFrame; pass++) {
+        movedTiles.clear();
+        if (!m_terrain.relaxSand(m_activeTiles, maxStep, m_params.rate, m_params.minExcess, movedTiles)) {
+            clear();
+            return;
+        }
+        // normals are derived on the GPU, so only the tiles that moved need anything
+        changedTiles.insert(movedTiles.begin(), movedTiles.end());
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        bool lastPass = pass == m_params.maxPassesPerFrame - 1 || elapsed.count() >= m_params.frameBudgetMs;
+
+        // the caller journaled the tiles active before this step, so new ones may
+        // only join for the next step
+        retainAround(movedTiles, lastPass);
+        if (lastPass) break;
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef SANDRELAXER_H
+#define SANDRELAXER_H
+
+#include <unordered_set>
+#include <vector>
+#include "terrain.h"
+
+struct SandParams {
+    float reposeAngle = 25.0f;      // degrees; steeper slopes slump until they reach it
+    float rate = 0.125f;            // fraction of the excess moved across each edge per pass (<= 1/8 is stable)
+    float minExcess = 1e-5f;        // excess height below which sand counts as settled
+    double frameBudgetMs = 2.0;     // relaxation time allowed per frame
+    int maxPassesPerFrame = 16;
+};
+
+// Lets freshly sculpted sand settle. Sculpted tiles and their edge neighbours are
+// activated, and each frame the active tiles are relaxed for as many passes as the
+// frame budget allows. After every pass only the tiles where sand moved, and their
+// edge neighbours, stay active; once a pass moves nothing, all go quiet again.
+class SandRelaxer
+{
+public:
+    SandRelaxer(Terrain& terrain);
+
+    void setParams(const SandParams& params) { m_params = params; }
+    const SandParams& getParams() { return m_params; }
+
+    void activate(const std::vector<int>& tiles);
+    bool isActive() { return !m_activeTiles.empty(); }
+    void clear();
+
+    // Tiles whose heights the next step() may change
+    const std::vector<int>& getActiveTiles() { return m_activeTiles; }
+
+    // Runs relaxation passes within the frame budget. Tiles whose heights changed
+    // are added to changedTiles.
+    void step(std::unordered_set<int>& changedTiles);
+
+private:
+    // Makes the tile and its edge neighbours active, as sand crossing an edge needs
+    // both sides; with admitNew false, only tiles that are already active are kept
+    void activateAround(int tileIndex, const std::vector<char>& wasActive, bool admitNew);
+    // Keeps only the tiles around those that moved in the last pass
+    void retainAround(const std::vector<int>& movedTiles, bool admitNew);
+
+    Terrain& m_terrain;
+    SandParams m_params;
+
+    std::vector<char> m_isActive;   // per tile
+    std::vector<int> m_activeTiles;
+};
+
+#endif // SANDRELAXER_H
@@ -0,0 +1,144 @@
+#include "sculptjournal.h"
+
+#include <algorithm>
+#include <cstring>
+
+SculptJournal::SculptJournal(Terrain& terrain, size_t budgetBytes)
+    : m_terrain(terrain),
+      m_budgetBytes(budgetBytes)
+{
+}
+
+void SculptJournal::captureTiles(const std::vector<int>& tiles) {
+    m_strokeActive = true;
+    for (int tileIndex : tiles) {
+        auto inserted = m_strokeBefore.try_emplace(tileIndex);
+        if (inserted.second) {
+            m_terrain.readTileDeltas(tileIndex, inserted.first->second);
+        }
+    }
+}
+
+void SculptJournal::endStroke() {
+    if (!m_strokeActive) return;
+    m_strokeActive = false;
+
+    Entry entry;
+    std::vector<float> after;
+    for (auto& [tileIndex, before] : m_strokeBefore) {
+        entry.tiles.push_back(tileIndex);
+
+        m_terrain.readTileDeltas(tileIndex, after);
+        TileChange change = {tileIndex, {}};
+        encodeXor(before, after, change.encodedXor);
+        if (change.encodedXor.empty()) continue;
+
+        entry.bytes += change.encodedXor.size() * sizeof(uint32_t);
+        entry.changes.push_back(std::move(change));
+    }
+    entry.bytes += entry.tiles.size() * sizeof(int);
+    m_strokeBefore.clear();
+
+    if (entry.changes.empty()) return;
+
+    // a new stroke forks history, so anything undone can no longer be redone
+    for (const Entry& old : m_redo) m_usedBytes -= old.bytes;
+    m_redo.clear();
+
+    m_usedBytes += entry.bytes;
+    m_undo.push_back(std::move(entry));
+    trimToBudget();
+}
+
+bool SculptJournal::undo(std::unordered_set<int>& tiles) {
+    endStroke();
+    if (m_undo.empty()) return false;
+    applyEntry(m_undo.back(), tiles);
+    m_redo.push_back(std::move(m_undo.back()));
+    m_undo.pop_back();
+    return true;
+}
+
+bool SculptJournal::redo(std::unordered_set<int>& tiles) {
+    endStroke();
+    if (m_redo.empty()) return false;
+    applyEntry(m_redo.back(), tiles);
+    m_undo.push_back(std::move(m_redo.back()));
+    m_redo.pop_back();
+    return true;
+}
+
+void SculptJournal::clear() {
+    m_strokeActive = false;
+    m_strokeBefore.clear();
+    m_undo.clear();
+    m_redo.clear();
+    m_usedBytes = 0;
+}
+
+void SculptJournal::applyEntry(const Entry& entry, std::unordered_set<int>& tiles) {
+    std::vector<float> deltas;
+    for (const TileChange& change : entry.changes) {
+        m_terrain.readTileDeltas(change.tileIndex, deltas);
+        applyXor(change.encodedXor, deltas);
+        m_terrain.writeTileDeltas(change.tileIndex, deltas);
+    }
+    tiles.insert(entry.tiles.begin(), entry.tiles.end());
+}
+
+// Drops the oldest strokes until the history fits; the newest stroke is always kept
+void SculptJournal::trimToBudget() {
+    while (m_usedBytes > m_budgetBytes && m_undo.size() > 1) {
+        m_usedBytes -= m_undo.front().bytes;
+        m_undo.pop_front();
+    }
+}
+
+// Encodes before ^ after as runs of [zeroCount, literalCount, literal words...].
+// Leaves encoded empty when nothing changed.
+void SculptJournal::encodeXor(const std::vector<float>& before, const std::vector<float>& after,
+                              std::vector<uint32_t>& encoded) {
+    encoded.clear();
+
+    size_t count = before.size();
+    std::vector<uint32_t> words(count);
+    bool changed = false;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t a, b;
+        std::memcpy(&a, &before[i], sizeof(a));
+        std::memcpy(&b, &after[i], sizeof(b));
+        words[i] = a ^ b;
+        changed |= words[i] != 0;
+    }
+    if (!changed) return;
+
+    size_t i = 0;
+    while (i < count) {
+        size_t zeroStart = i;
+        while (i < count && words[i] == 0) i++;
+        size_t literalStart = i;
+        while (i < count && words[i] != 0) i++;
+        if (literalStart == i) break;
+
+        encoded.push_back(literalStart - zeroStart);
+        encoded.push_back(i - literalStart);
+        encoded.insert(encoded.end(), words.begin() + literalStart, words.begin() + i);
+    }
+}
+
+void SculptJournal::applyXor(const std::vector<uint32_t>& encoded, std::vector<float>& deltas) {
+    size_t sample = 0;
+    size_t i = 0;
+    while (i < encoded.size()) {
+        sample += encoded[i];
+        uint32_t literals = encoded[i + 1];
+        i += 2;
+        for (uint32_t j = 0; j < literals; j++, sample++) {
+            uint32_t bits;
+            std::memcpy(&bits, &deltas[sample], sizeof(bits));
+            bits ^= encoded[i + j];
+            std::memcpy(&deltas[sample], &bits, sizeof(bits));
+        }
+        i += literals;
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef SCULPTJOURNAL_H
+#define SCULPTJOURNAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "terrain.h"
+
+// Undo/redo history for sculpting. Before a stroke first touches a tile, the
+// tile's delta heights are copied; when the stroke ends, each tile is stored as
+// the XOR of its before/after bits, run-length encoded. Samples the stroke
+// didn't reach XOR to zero, so a tile costs roughly what the stroke changed.
+// XOR is its own inverse, so undo and redo apply the same data.
+class SculptJournal
+{
+public:
+    SculptJournal(Terrain& terrain, size_t budgetBytes = 16 * 1024 * 1024);
+
+    // Call before the heights of these tiles change; the first call starts a stroke
+    void captureTiles(const std::vector<int>& tiles);
+
+    // Closes the current stroke and pushes it as one history entry
+    void endStroke();
+
+    // Restore the previous/next state. The tiles that need re-uploading are added to
+    // tiles. Each returns false when there is nothing to undo/redo.
+    bool undo(std::unordered_set<int>& tiles);
+    bool redo(std::unordered_set<int>& tiles);
+
+    // Forget all history, e.g. after the delta layer is replaced wholesale
+    void clear();
+
+private:
+    struct TileChange {
+        int tileIndex;
+        std::vector<uint32_t> encodedXor;
+    };
+
+    struct Entry {
+        std::vector<int> tiles;             // every tile the stroke touched
+        std::vector<TileChange> changes;    // only the tiles whose deltas changed
+        size_t bytes = 0;
+    };
+
+    void applyEntry(const Entry& entry, std::unordered_set<int>& tiles);
+    void trimToBudget();
+
+    static void encodeXor(const std::vector<float>& before, const std::vector<float>& after,
+                          std::vector<uint32_t>& encoded);
+    static void applyXor(const std::vector<uint32_t>& encoded, std::vector<float>& deltas);
+
+    Terrain& m_terrain;
+    size_t m_budgetBytes;
+    size_t m_usedBytes = 0;
+
+    bool m_strokeActive = false;
+    std::unordered_map<int, std::vector<float>> m_strokeBefore;
+
+    std::deque<Entry> m_undo;
+    std::vector<Entry> m_redo;
+};
+
+#endif // SCULPTJOURNAL_H
@@ -4,43 +4,225 @@
 #include "glm/glm.hpp"
 #include <iostream>
 #include <algorithm>
+#include <mutex>
 #include <set>
 
-// Constructor
-Terrain::Terrain()
+// Widest SIMD path the compiler targets; anything else uses the scalar computePerlin()
+#if defined(__AVX2__)
+#define TERRAIN_PERLIN_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TERRAIN_PERLIN_SSE2
+#include <emmintrin.h>
+#endif
+
+// Constructor; the seed selects which garden the noise produces
+Terrain::Terrain(uint32_t seed, const NoiseParams& noise)
 {
     m_wireshade = false;
+    m_seed = seed;
 
     // Define resolution of terrain generation
     m_resolution = 100;
     m_tilesPerSide = 10;  // 10x10 grid of tiles
     m_tileResolution = m_resolution / m_tilesPerSide;  // 10 vertices per tile
 
-    // Generate random vector lookup table
-    m_lookupSize = 1024;
-    m_randVecLookup.reserve(m_lookupSize);
+    // Color ramp, evaluated per vertex in terrain.vert
+    m_sandColor = glm::vec3(.95, .9, .6);
+    m_colorHeightMin = -.5f;
+    m_colorHeightMax = .5f;
 
-    // Initialize random number generator
-    std::srand(1230);
+    int side = m_resolution + 3;
+    m_heightDeltas.assign(side * side, 0.0f);
 
-    // Populate random vector lookup table
-    for (int i = 0; i < m_lookupSize; i++)
-    {
-        m_randVecLookup.push_back(glm::vec2(std::rand() * 2.0 / RAND_MAX - 1.0,
-                                            std::rand() * 2.0 / RAND_MAX - 1.0));
+    setNoiseParams(noise);
+}
+
+// Refills the base heights with new fBm settings
+void Terrain::setNoiseParams(const NoiseParams& noise) {
+    std::unique_lock lock(m_heightMutex);
+    storeNoiseParams(noise);
+    fillHeights();
+}
+
+// Stores the fBm settings and precomputes the per-octave scales
+void Terrain::storeNoiseParams(const NoiseParams& noise) {
+    m_noise = noise;
+    m_noise.octaves = std::clamp(noise.octaves, 1, kMaxOctaves);
+
+    float frequency = m_noise.frequency;
+    float amplitude = m_noise.amplitude;
+    for (int o = 0; o < kMaxOctaves; o++) {
+        m_octaveFrequency[o] = frequency;
+        m_octaveAmplitude[o] = amplitude;
+        frequency *= m_noise.lacunarity;
+        amplitude *= m_noise.gain;
+    }
+}
+
+void Terrain::readHeightLayers(std::vector<float>& baseHeights, std::vector<float>& heightDeltas) {
+    std::shared_lock lock(m_heightMutex);
+    baseHeights = m_baseHeights;
+    heightDeltas = m_heightDeltas;
+}
+
+void Terrain::readHeights(int startRow, int endRow, int startCol, int endCol, std::vector<float>& heights) {
+    std::shared_lock lock(m_heightMutex);
+    for (int row = startRow; row < endRow; row++) {
+        int first = getGridIndex(row, startCol);
+        for (int i = first; i < first + (endCol - startCol); i++) {
+            heights[i] = m_baseHeights[i] + m_heightDeltas[i];
+        }
     }
 }
 
+// Both arrays hold getGridSampleCount() samples
+void Terrain::restoreHeightLayers(uint32_t seed, const NoiseParams& noise,
+                                  const float* baseHeights, const float* heightDeltas) {
+    std::unique_lock lock(m_heightMutex);
+    m_seed = seed;
+    storeNoiseParams(noise);
+
+    int count = getGridSampleCount();
+    m_baseHeights.assign(baseHeights, baseHeights + count);
+    m_heightDeltas.assign(heightDeltas, heightDeltas + count);
+}
+
 // Destructor
 Terrain::~Terrain()
 {
-    m_randVecLookup.clear();
-    m_displacements.clear();
+    m_baseHeights.clear();
+    m_heightDeltas.clear();
+}
+
+// Evaluates the noise once for every grid sample (including the apron). All later
+// height queries read this cache, so extra octaves only cost at generation time.
+void Terrain::fillHeights() {
+    int side = m_resolution + 3;
+    m_baseHeights.assign(side * side, 0.0f);
+
+    // normalized coordinates of the columns, shared by every row
+    std::vector<float> ys(side);
+    for (int col = -1; col <= m_resolution + 1; col++) {
+        ys[col + 1] = 1.0 * col / m_resolution;
+    }
+
+    // each row writes only its own slice of the grid
+    m_threadPool.parallelFor(side, [&](int i) {
+        int row = i - 1;
+        float x = 1.0 * row / m_resolution;
+        computeFbmRow(x, ys.data(), side, &m_baseHeights[getGridIndex(row, -1)]);
+    });
+}
+
+// Shapes one octave's raw Perlin value according to the variant
+template <NoiseVariant Variant>
+static inline float shapeOctave(float n) {
+    if constexpr (Variant == NoiseVariant::Billow) {
+        return std::abs(n);
+    } else if constexpr (Variant == NoiseVariant::Ridged) {
+        float r = 1.0f - std::abs(n);
+        return r * r;
+    } else {
+        return n;
+    }
 }
 
-// add a dip at the specified location
+// Shifts each octave so the lattices don't all line up at the origin
+static constexpr float kOctaveOffset = 17.31f;
+
+// Sums Octaves layers of noise over one row at normalized x and normalized ys[j]
+template <int Octaves, NoiseVariant Variant>
+void Terrain::computeFbmRowImpl(float x, const float* ys, int count, float* out) {
+    std::vector<float> xs(count);
+    std::vector<float> ysOctave(count);
+    std::vector<float> noise(count);
+
+    std::fill(out, out + count, 0.0f);
+    for (int o = 0; o < Octaves; o++) {
+        float frequency = m_octaveFrequency[o];
+        float offset = o * kOctaveOffset;
+        std::fill(xs.begin(), xs.end(), x * frequency + offset);
+        for (int j = 0; j < count; j++) {
+            ysOctave[j] = ys[j] * frequency + offset;
+        }
+
+        computePerlinBatch(xs.data(), ysOctave.data(), count, noise.data());
+
+        float amplitude = m_octaveAmplitude[o];
+        for (int j = 0; j < count; j++) {
+            out[j] += amplitude * shapeOctave<Variant>(noise[j]);
+        }
+    }
+}
+
+template <int Octaves>
+void Terrain::dispatchFbmVariant(float x, const float* ys, int count, float* out) {
+    switch (m_noise.variant) {
+    case NoiseVariant::Billow: computeFbmRowImpl<Octaves, NoiseVariant::Billow>(x, ys, count, out); break;
+    case NoiseVariant::Ridged: computeFbmRowImpl<Octaves, NoiseVariant::Ridged>(x, ys, count, out); break;
+    default: computeFbmRowImpl<Octaves, NoiseVariant::Standard>(x, ys, count, out); break;
+    }
+}
+
+// Picks the specialization for the current octave count (already clamped to kMaxOctaves)
+void Terrain::computeFbmRow(float x, const float* ys, int count, float* out) {
+    static_assert(kMaxOctaves == 8, "add dispatch cases when changing kMaxOctaves");
+    switch (m_noise.octaves) {
+    case 1: dispatchFbmVariant<1>(x, ys, count, out); break;
+    case 2: dispatchFbmVariant<2>(x, ys, count, out); break;
+    case 3: dispatchFbmVariant<3>(x, ys, count, out); break;
+    case 4: dispatchFbmVariant<4>(x, ys, count, out); break;
+    case 5: dispatchFbmVariant<5>(x, ys, count, out); break;
+    case 6: dispatchFbmVariant<6>(x, ys, count, out); break;
+    case 7: dispatchFbmVariant<7>(x, ys, count, out); break;
+    default: dispatchFbmVariant<8>(x, ys, count, out); break;
+    }
+}
+
+// Bilinearly samples a grid-layout array at a normalized (x, y) position
+float Terrain::sampleGrid(const std::vector<float>& grid, float x, float y) {
+    float fx = glm::clamp(x * m_resolution, -1.0f, (float)m_resolution + 1);
+    float fy = glm::clamp(y * m_resolution, -1.0f, (float)m_resolution + 1);
+    int row = std::min((int)std::floor(fx), m_resolution);
+    int col = std::min((int)std::floor(fy), m_resolution);
+    float tx = fx - row;
+    float ty = fy - col;
+
+    float h00 = grid[getGridIndex(row, col)];
+    float h10 = grid[getGridIndex(row + 1, col)];
+    float h01 = grid[getGridIndex(row, col + 1)];
+    float h11 = grid[getGridIndex(row + 1, col + 1)];
+    return glm::mix(glm::mix(h00, h10, tx), glm::mix(h01, h11, tx), ty);
+}
+
+// add a dip at the specified location, baked straight into the height delta layer
 void Terrain::divot(float x, float y, float depth, float radius) {
-    m_displacements.push_back(glm::vec4(x, y, depth, radius));
+    std::unique_lock lock(m_heightMutex);
+
+    int minRow = std::max(-1, (int)std::floor((x - radius) * m_resolution));
+    int maxRow = std::min(m_resolution + 1, (int)std::ceil((x + radius) * m_resolution));
+    int minCol = std::max(-1, (int)std::floor((y - radius) * m_resolution));
+    int maxCol = std::min(m_resolution + 1, (int)std::ceil((y + radius) * m_resolution));
+
+    for (int row = minRow; row <= maxRow; row++) {
+        for (int col = minCol; col <= maxCol; col++) {
+            float px = 1.0 * row / m_resolution;
+            float py = 1.0 * col / m_resolution;
+
+            // calculate distance from this sample to crater center
+            float dx = px - x;
+            float dy = py - y;
+            float distance = std::sqrt(dx * dx + dy * dy);
+
+            // smooth step
+            if (distance < radius) {
+                float t = distance / radius;
+                float falloff = 1.0f - (3.0f * t * t - 2.0f * t * t * t);
+                m_heightDeltas[getGridIndex(row, col)] -= depth * falloff;
+            }
+        }
+    }
 }
 
 // calculate which tile contains the clicked coordinates
@@ -53,13 +235,12 @@ void Terrain::getTileCoordinates(float x, float y, int& tileX, int& tileY) {
 
 // get all tiles affected by a crater at (x, y) with given radius
 std::vector<int> Terrain::getAffectedTiles(float x, float y, float radius) {
-    std::set<int> affectedTilesSet;
+    return getTilesInRect(x - radius, y - radius, x + radius, y + radius);
+}
 
-    // bounding box
-    float minX = x - radius;
-    float maxX = x + radius;
-    float minY = y - radius;
-    float maxY = y + radius;
+// get all tiles overlapping a rectangle, plus one tile of padding for the normals
+std::vector<int> Terrain::getTilesInRect(float minX, float minY, float maxX, float maxY) {
+    std::set<int> affectedTilesSet;
 
     // convert to tile coordinates
     int minTileX, minTileY, maxTileX, maxTileY;
@@ -81,190 +262,188 @@ std::vector<int> Terrain::getAffectedTiles(float x, float y, float radius) {
     return affectedTiles;
 }
 
-float Terrain::getHeightModification(float x, float y) {
-    float totalModification = 0.0f;
-
-    for (const auto& crater : m_displacements) {
-        float craterX = crater.x;
-        float craterY = crater.y;
-        float depth = crater.z;
-        float radius = crater.w;
-
-        // calculate distance from this point to crater center
-        float dx = x - craterX;
-        float dy = y - craterY;
-        float distance = std::sqrt(dx * dx + dy * dy);
-
-        // smooth step
-        if (distance < radius) {
-            float t = distance / radius;
-            float falloff = 1.0f - (3.0f * t * t - 2.0f * t * t * t);
-            totalModification -= depth * falloff;
-        }
-    }
-
-    return totalModification;
+// grid vertices owned by a tile: [startRow, endRow) x [startCol, endCol)
+// the last tile in each direction also owns the closing row/column of the grid,
+// so every vertex of the (res+1)^2 grid belongs to exactly one tile
+void Terrain::getTileVertexRange(int tileX, int tileY, int& startRow, int& endRow, int& startCol, int& endCol) {
+    startRow = tileX * m_tileResolution;
+    startCol = tileY * m_tileResolution;
+    endRow = (tileX == m_tilesPerSide - 1) ? m_resolution + 1 : startRow + m_tileResolution;
+    endCol = (tileY == m_tilesPerSide - 1) ? m_resolution + 1 : startCol + m_tileResolution;
 }
 
-// Helper for generateTerrain()
-void addPointToVector(glm::vec3 point, std::vector<float>& vector) {
-    vector.push_back(point.x);
-    vector.push_back(point.y);
-    vector.push_back(point.z);
+void Terrain::getTileGridRange(int tileX, int tileY, int& startRow, int& endRow, int& startCol, int& endCol) {
+    getTileVertexRange(tileX, tileY, startRow, endRow, startCol, endCol);
+    if (tileX == 0) startRow = -1;
+    if (tileY == 0) startCol = -1;
+    if (tileX == m_tilesPerSide - 1) endRow = m_resolution + 2;
+    if (tileY == m_tilesPerSide - 1) endCol = m_resolution + 2;
 }
 
-// generate a single tile
-std::vector<float> Terrain::generateTile(int tileX, int tileY) {
-    std::vector<float> verts;
-    verts.reserve(m_tileResolution * m_tileResolution * 54);
-
-    int startX = tileX * m_tileResolution;
-    int startY = tileY * m_tileResolution;
-
-    for(int x = startX; x < startX + m_tileResolution; x++) {
-        for(int y = startY; y < startY + m_tileResolution; y++) {
-            int x1 = x;
-            int y1 = y;
-            int x2 = x + 1;
-            int y2 = y + 1;
-
-            glm::vec3 p1 = getPosition(x1, y1);
-            glm::vec3 p2 = getPosition(x2, y1);
-            glm::vec3 p3 = getPosition(x2, y2);
-            glm::vec3 p4 = getPosition(x1, y2);
-
-            glm::vec3 n1 = getNormal(x1, y1);
-            glm::vec3 n2 = getNormal(x2, y1);
-            glm::vec3 n3 = getNormal(x2, y2);
-            glm::vec3 n4 = getNormal(x1, y2);
-
-            // triangle 1
-            addPointToVector(p1, verts);
-            addPointToVector(n1, verts);
-            addPointToVector(getColor(n1, p1), verts);
+void Terrain::readTileDeltas(int tileIndex, std::vector<float>& deltas) {
+    std::shared_lock lock(m_heightMutex);
 
-            addPointToVector(p2, verts);
-            addPointToVector(n2, verts);
-            addPointToVector(getColor(n2, p2), verts);
+    int startRow, endRow, startCol, endCol;
+    getTileGridRange(tileIndex % m_tilesPerSide, tileIndex / m_tilesPerSide, startRow, endRow, startCol, endCol);
 
-            addPointToVector(p3, verts);
-            addPointToVector(n3, verts);
-            addPointToVector(getColor(n3, p3), verts);
+    deltas.clear();
+    deltas.reserve((endRow - startRow) * (endCol - startCol));
+    for (int row = startRow; row < endRow; row++) {
+        const float* src = &m_heightDeltas[getGridIndex(row, startCol)];
+        deltas.insert(deltas.end(), src, src + (endCol - startCol));
+    }
+}
 
-            // triangle 2
-            addPointToVector(p1, verts);
-            addPointToVector(n1, verts);
-            addPointToVector(getColor(n1, p1), verts);
+void Terrain::writeTileDeltas(int tileIndex, const std::vector<float>& deltas) {
+    std::unique_lock lock(m_heightMutex);
 
-            addPointToVector(p3, verts);
-            addPointToVector(n3, verts);
-            addPointToVector(getColor(n3, p3), verts);
+    int startRow, endRow, startCol, endCol;
+    getTileGridRange(tileIndex % m_tilesPerSide, tileIndex / m_tilesPerSide, startRow, endRow, startCol, endCol);
 
-            addPointToVector(p4, verts);
-            addPointToVector(n4, verts);
-            addPointToVector(getColor(n4, p4), verts);
-        }
+    const float* src = deltas.data();
+    for (int row = startRow; row < endRow; row++) {
+        std::copy(src, src + (endCol - startCol), &m_heightDeltas[getGridIndex(row, startCol)]);
+        src += endCol - startCol;
     }
-    return verts;
 }
 
-// tile-specific vbo copy
-void Terrain::updateTile(int tileX, int tileY, std::vector<float>& allVerts) {
-    std::vector<float> tileVerts = generateTile(tileX, tileY);
+bool Terrain::relaxSand(const std::vector<int>& tiles, float maxStep, float rate, float minExcess,
+                        std::vector<int>& movedTiles) {
+    if (tiles.empty()) return false;
+
+    // grid-sample range of every tile, and the rectangle around all of them
+    std::vector<glm::ivec4> ranges(tiles.size());
+    int startRow = m_resolution + 2, endRow = -1, startCol = m_resolution + 2, endCol = -1;
+    for (size_t k = 0; k < tiles.size(); k++) {
+        glm::ivec4& range = ranges[k];
+        getTileGridRange(tiles[k] % m_tilesPerSide, tiles[k] / m_tilesPerSide, range.x, range.y, range.z, range.w);
+        startRow = std::min(startRow, range.x);
+        endRow = std::max(endRow, range.y);
+        startCol = std::min(startCol, range.z);
+        endCol = std::max(endCol, range.w);
+    }
+    int rows = endRow - startRow;
+    int cols = endCol - startCol;
+
+    // only the GUI thread writes heights, so a snapshot taken under the shared lock
+    // stays valid while the workers compute. Only the tiles' own samples are copied
+    // and marked; sand never crosses into the rest of the rectangle.
+    std::vector<float> heights(rows * cols);
+    std::vector<float> deltas(rows * cols);
+    std::vector<char> inTiles(rows * cols, 0);
+    {
+        std::shared_lock lock(m_heightMutex);
+        for (const glm::ivec4& range : ranges) {
+            for (int r = range.x; r < range.y; r++) {
+                for (int c = range.z; c < range.w; c++) {
+                    int i = getGridIndex(r, c);
+                    int local = (r - startRow) * cols + c - startCol;
+                    heights[local] = m_baseHeights[i] + m_heightDeltas[i];
+                    deltas[local] = m_heightDeltas[i];
+                    inTiles[local] = 1;
+                }
+            }
+        }
+    }
 
-    int tileIndex = tileY * m_tilesPerSide + tileX;
-    int vertsPerTile = m_tileResolution * m_tileResolution * 54;
-    int startIndex = tileIndex * vertsPerTile;
+    // sand moving from a sample at height `from` to a neighbour at height `to`.
+    // flux(a, b) == -flux(b, a) bit for bit, so every transfer balances.
+    auto flux = [&](float from, float to) {
+        float diff = from - to;
+        float excess = std::abs(diff) - maxStep;
+        if (excess <= minExcess) return 0.0f;
+        return std::copysign(rate * excess, diff);
+    };
 
-    // copy the tile vertices into the main buffer
-    for (size_t i = 0; i < tileVerts.size(); i++) {
-        allVerts[startIndex + i] = tileVerts[i];
+    // tiles own disjoint samples, so each worker writes only its own tile's deltas
+    std::vector<char> tileMoved(tiles.size(), 0);
+    m_threadPool.parallelFor(tiles.size(), [&](int k) {
+        const glm::ivec4& range = ranges[k];
+        for (int r = range.x - startRow; r < range.y - startRow; r++) {
+            for (int c = range.z - startCol; c < range.w - startCol; c++) {
+                int i = r * cols + c;
+                float h = heights[i];
+                float change = 0.0f;
+                if (r > 0 && inTiles[i - cols]) change -= flux(h, heights[i - cols]);
+                if (r < rows - 1 && inTiles[i + cols]) change -= flux(h, heights[i + cols]);
+                if (c > 0 && inTiles[i - 1]) change -= flux(h, heights[i - 1]);
+                if (c < cols - 1 && inTiles[i + 1]) change -= flux(h, heights[i + 1]);
+
+                if (change != 0.0f) {
+                    deltas[i] += change;
+                    tileMoved[k] = 1;
+                }
+            }
+        }
+    });
+
+    bool moved = false;
+    std::unique_lock lock(m_heightMutex);
+    for (size_t k = 0; k < tiles.size(); k++) {
+        if (!tileMoved[k]) continue;
+        moved = true;
+        movedTiles.push_back(tiles[k]);
+
+        const glm::ivec4& range = ranges[k];
+        for (int r = range.x - startRow; r < range.y - startRow; r++) {
+            std::copy(&deltas[r * cols + range.z - startCol], &deltas[r * cols + range.w - startCol],
+                      &m_heightDeltas[getGridIndex(startRow + r, range.z)]);
+        }
     }
-
+    return moved;
 }
 
-// Generates the geometry of the entire terrain (all tiles)
-std::vector<float> Terrain::generateTerrain() {
-    std::vector<float> verts;
-    int totalVerts = m_resolution * m_resolution * 54;
-    verts.reserve(totalVerts);
-
-    // Generate all tiles
-    for (int tileY = 0; tileY < m_tilesPerSide; tileY++) {
-        for (int tileX = 0; tileX < m_tilesPerSide; tileX++) {
-            std::vector<float> tileVerts = generateTile(tileX, tileY);
-            verts.insert(verts.end(), tileVerts.begin(), tileVerts.end());
-        }
+// height extent of the vertices a tile draws; its cells also reach the first
+// row/column of the neighbouring tiles, so those are included
+TileBounds Terrain::getTileBounds(int tileX, int tileY, const std::vector<float>& heights) {
+    int startRow = tileX * m_tileResolution;
+    int startCol = tileY * m_tileResolution;
+
+    TileBounds bounds = {INFINITY, -INFINITY};
+    for (int row = startRow; row <= startRow + m_tileResolution; row++) {
+        const float* rowHeights = &heights[getGridIndex(row, startCol)];
+        auto [lo, hi] = std::minmax_element(rowHeights, rowHeights + m_tileResolution + 1);
+        bounds.minHeight = std::min(bounds.minHeight, *lo);
+        bounds.maxHeight = std::max(bounds.maxHeight, *hi);
     }
+    return bounds;
+}
 
-    return verts;
+// Integer hash of a lattice point: multiply the coordinates by large odd constants,
+// mix in the seed, then run the murmur3 finalizer. Pure 32-bit integer math, so
+// it is identical on every platform and maps directly onto SIMD lanes.
+static inline uint32_t hashLatticePoint(uint32_t seed, int row, int col) {
+    uint32_t h = seed ^ ((uint32_t)row * 0x8da6b343u) ^ ((uint32_t)col * 0xd8163841u);
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
 }
 
-// Samples the (infinite) random vector grid at (row, col)
+// Samples the (infinite) random vector grid at (row, col); each 16-bit half of the
+// hash becomes one gradient component in [-1, 1]
 glm::vec2 Terrain::sampleRandomVector(int row, int col)
 {
-    std::hash<int> intHash;
-    int index = intHash(row * 41 + col * 43) % m_lookupSize;
-    return m_randVecLookup.at(index);
+    uint32_t h = hashLatticePoint(m_seed, row, col);
+    return glm::vec2((float)(h & 0xFFFF) * (2.0f / 65535.0f) - 1.0f,
+                     (float)(h >> 16) * (2.0f / 65535.0f) - 1.0f);
 }
 
-// Takes a grid coordinate (row, col), [0, m_resolution), which describes a vertex in a plane mesh
-// Returns a normalized position (x, y, z); x and y in range from [0, 1), and z is obtained from getHeight()
-glm::vec3 Terrain::getPosition(int row, int col) {
-    float x = 1.0 * row / m_resolution;
-    float y = 1.0 * col / m_resolution;
-    float z = getHeight(x, y);
-    return glm::vec3(x, y, z);
-}
-
-// Helper for computePerlin() and, possibly, getColor()
+// Helper for computePerlin()
 float interpolate(float A, float B, float alpha) {
     float ease = (3*alpha*alpha) - (2*alpha*alpha*alpha);
     return A + ease*(B-A);
 }
 
-// Takes a normalized (x, y) position, in range [0,1)
-// Returns a height value, z, by sampling a noise function
+// Takes a normalized (x, y) position, in range [0,1]
+// Returns a height value, z, by sampling the cached noise and delta grids
 float Terrain::getHeight(float x, float y) {
-    float z = computePerlin(x * 512, y * 512) / 512;
-    return z + getHeightModification(x, y);
-}
-
-
-// Computes the normal of a vertex by averaging neighbors
-glm::vec3 Terrain::getNormal(int row, int col) {
-    glm::vec3 V = getPosition(row, col);
-    glm::vec3 normals = {0, 0, 0};
-    std::vector<std::vector<int>> neighbors = {
-        {-1, -1}, {0, -1}, {1, -1}, {1, 0},
-        {1, 1}, {0, 1}, {-1, 1}, {-1, 0}
-    };
-
-    for (int i = 0; i < 8; ++i) {
-        int niRowOffset = neighbors[i][0];
-        int niColOffset = neighbors[i][1];
-        int ni2RowOffset = neighbors[(i + 1) % 8][0];
-        int ni2ColOffset = neighbors[(i + 1) % 8][1];
-        glm::vec3 ni = getPosition(row + niRowOffset, col + niColOffset);
-        glm::vec3 ni2 = getPosition(row + ni2RowOffset, col + ni2ColOffset);
-        normals += glm::cross(ni - V, ni2 - V);
-    }
-    return glm::normalize(normals);
+    std::shared_lock lock(m_heightMutex);
+    return sampleGrid(m_baseHeights, x, y) + sampleGrid(m_heightDeltas, x, y);
 }
 
-// Computes color of vertex using normal and, optionally, position
-glm::vec3 Terrain::getColor(glm::vec3 normal, glm::vec3 position) {
-    float a = glm::clamp((position.z + .5f) / (.5f + .5f), 0.0f, 1.0f);
-    float ease = (3 * a * a) - (2 * a * a * a);
-    glm::vec3 color = {.95, .9, .6};
-    color = {interpolate(color.r, ease, ease), interpolate(color.g, ease, ease),
-             interpolate(color.b, ease, ease)};
-
-    a = glm::dot(normal, glm::vec3(0, 0, 1));
-    ease = (3 * a * a) - (2 * a * a * a);
-    return glm::vec3(interpolate(1.f, color.r, ease), interpolate(1.f, color.g, ease),
-                     interpolate(1.f, color.b, ease));
-}
 
 // Computes the intensity of Perlin noise at some point
 float Terrain::computePerlin(float x, float y) {
@@ -285,3 +464,139 @@ float Terrain::computePerlin(float x, float y) {
 
     return interpolate(interpolate(D, C, x - std::floor(x)), interpolate(A, B, x - std::floor(x)), y - std::floor(y));
 }
+
+#if defined(TERRAIN_PERLIN_AVX2)
+// Vector form of interpolate(), with the same operation order so results match bit for bit
+static inline __m256 interpolate8(__m256 A, __m256 B, __m256 alpha) {
+    __m256 ease = _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(3.0f), alpha), alpha),
+                                _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(2.0f), alpha), alpha), alpha));
+    return _mm256_add_ps(A, _mm256_mul_ps(ease, _mm256_sub_ps(B, A)));
+}
+
+// dot(sampleRandomVector(row, col), (ox, oy)) for eight corners at once
+static inline __m256 gradientDot8(uint32_t seed, __m256i row, __m256i col, __m256 ox, __m256 oy) {
+    __m256i h = _mm256_xor_si256(_mm256_set1_epi32(seed),
+                                 _mm256_xor_si256(_mm256_mullo_epi32(row, _mm256_set1_epi32(0x8da6b343u)),
+                                                  _mm256_mullo_epi32(col, _mm256_set1_epi32(0xd8163841u))));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32(0x85ebca6bu));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32(0xc2b2ae35u));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+
+    __m256 scale = _mm256_set1_ps(2.0f / 65535.0f);
+    __m256 one = _mm256_set1_ps(1.0f);
+    __m256 gx = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(h, _mm256_set1_epi32(0xFFFF))), scale), one);
+    __m256 gy = _mm256_sub_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(h, 16)), scale), one);
+    return _mm256_add_ps(_mm256_mul_ps(gx, ox), _mm256_mul_ps(gy, oy));
+}
+#elif defined(TERRAIN_PERLIN_SSE2)
+static inline __m128 interpolate4(__m128 A, __m128 B, __m128 alpha) {
+    __m128 ease = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(3.0f), alpha), alpha),
+                             _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_set1_ps(2.0f), alpha), alpha), alpha));
+    return _mm_add_ps(A, _mm_mul_ps(ease, _mm_sub_ps(B, A)));
+}
+
+// SSE2 has no floor; truncate and step down where truncation rounded up
+static inline __m128 floor4(__m128 x) {
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.0f)));
+}
+
+// SSE2 has no 32-bit low multiply; build it from two 32x32->64 multiplies
+static inline __m128i mullo4(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline __m128 gradientDot4(uint32_t seed, __m128i row, __m128i col, __m128 ox, __m128 oy) {
+    __m128i h = _mm_xor_si128(_mm_set1_epi32(seed),
+                              _mm_xor_si128(mullo4(row, _mm_set1_epi32(0x8da6b343u)),
+                                            mullo4(col, _mm_set1_epi32(0xd8163841u))));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+    h = mullo4(h, _mm_set1_epi32(0x85ebca6bu));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 13));
+    h = mullo4(h, _mm_set1_epi32(0xc2b2ae35u));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+
+    __m128 scale = _mm_set1_ps(2.0f / 65535.0f);
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 gx = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(h, _mm_set1_epi32(0xFFFF))), scale), one);
+    __m128 gy = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(h, 16)), scale), one);
+    return _mm_add_ps(_mm_mul_ps(gx, ox), _mm_mul_ps(gy, oy));
+}
+#endif
+
+// Evaluates computePerlin(xs[i], ys[i]) for count points, several lanes at a time.
+// Every lane performs the same float operations in the same order as the scalar
+// version, so the output is bit-identical to calling computePerlin() in a loop.
+void Terrain::computePerlinBatch(const float* xs, const float* ys, int count, float* out) {
+    int i = 0;
+
+#if defined(TERRAIN_PERLIN_AVX2)
+    __m256 one = _mm256_set1_ps(1.0f);
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(xs + i);
+        __m256 y = _mm256_loadu_ps(ys + i);
+        __m256 x0 = _mm256_floor_ps(x);
+        __m256 y0 = _mm256_floor_ps(y);
+        __m256 x1 = _mm256_add_ps(x0, one);
+        __m256 y1 = _mm256_add_ps(y0, one);
+
+        __m256i row0 = _mm256_cvttps_epi32(x0);
+        __m256i row1 = _mm256_cvttps_epi32(x1);
+        __m256i col0 = _mm256_cvttps_epi32(y0);
+        __m256i col1 = _mm256_cvttps_epi32(y1);
+
+        __m256 ox0 = _mm256_sub_ps(x0, x);
+        __m256 ox1 = _mm256_sub_ps(x1, x);
+        __m256 oy0 = _mm256_sub_ps(y0, y);
+        __m256 oy1 = _mm256_sub_ps(y1, y);
+
+        __m256 A = gradientDot8(m_seed, row0, col1, ox0, oy1);
+        __m256 B = gradientDot8(m_seed, row1, col1, ox1, oy1);
+        __m256 C = gradientDot8(m_seed, row1, col0, ox1, oy0);
+        __m256 D = gradientDot8(m_seed, row0, col0, ox0, oy0);
+
+        __m256 tx = _mm256_sub_ps(x, x0);
+        __m256 ty = _mm256_sub_ps(y, y0);
+        _mm256_storeu_ps(out + i, interpolate8(interpolate8(D, C, tx), interpolate8(A, B, tx), ty));
+    }
+#elif defined(TERRAIN_PERLIN_SSE2)
+    __m128 one = _mm_set1_ps(1.0f);
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(xs + i);
+        __m128 y = _mm_loadu_ps(ys + i);
+        __m128 x0 = floor4(x);
+        __m128 y0 = floor4(y);
+        __m128 x1 = _mm_add_ps(x0, one);
+        __m128 y1 = _mm_add_ps(y0, one);
+
+        __m128i row0 = _mm_cvttps_epi32(x0);
+        __m128i row1 = _mm_cvttps_epi32(x1);
+        __m128i col0 = _mm_cvttps_epi32(y0);
+        __m128i col1 = _mm_cvttps_epi32(y1);
+
+        __m128 ox0 = _mm_sub_ps(x0, x);
+        __m128 ox1 = _mm_sub_ps(x1, x);
+        __m128 oy0 = _mm_sub_ps(y0, y);
+        __m128 oy1 = _mm_sub_ps(y1, y);
+
+        __m128 A = gradientDot4(m_seed, row0, col1, ox0, oy1);
+        __m128 B = gradientDot4(m_seed, row1, col1, ox1, oy1);
+        __m128 C = gradientDot4(m_seed, row1, col0, ox1, oy0);
+        __m128 D = gradientDot4(m_seed, row0, col0, ox0, oy0);
+
+        __m128 tx = _mm_sub_ps(x, x0);
+        __m128 ty = _mm_sub_ps(y, y0);
+        _mm_storeu_ps(out + i, interpolate4(interpolate4(D, C, tx), interpolate4(A, B, tx), ty));
+    }
+#endif
+
+    // scalar fallback and remainder
+    for (; i < count; i++) {
+        out[i] = computePerlin(xs[i], ys[i]);
+    }
+}
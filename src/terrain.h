@@ -1,9 +1,13 @@
 #ifndef Terrain_H
 #define Terrain_H
 
+#include <array>
+#include <cstdint>
 #include <vector>
 #include <map>
+#include <shared_mutex>
 #include "glm/glm.hpp"
+#include "utils/threadpool.h"
 
 struct TerrainTile {
     std::vector<float> vertices;
@@ -12,47 +16,131 @@ struct TerrainTile {
     bool needsUpdate;
 };
 
+// Height extent of a tile's grid samples, for culling and LOD selection
+struct TileBounds {
+    float minHeight;
+    float maxHeight;
+};
+
+// How each octave's Perlin value is shaped before it is summed
+enum class NoiseVariant {
+    Standard,   // signed noise, soft rolling dunes
+    Billow,     // |n|, rounded mounds
+    Ridged      // (1 - |n|)^2, sharp crests
+};
+
+// Fractal Brownian motion settings; the defaults reproduce the original single octave
+struct NoiseParams {
+    int octaves = 1;                    // clamped to [1, Terrain::kMaxOctaves]
+    float frequency = 512.0f;           // noise cells across the terrain for the first octave
+    float amplitude = 1.0f / 512.0f;    // height scale of the first octave
+    float lacunarity = 2.0f;            // frequency multiplier per octave
+    float gain = 0.5f;                  // amplitude multiplier per octave
+    NoiseVariant variant = NoiseVariant::Standard;
+};
+
 class Terrain
 {
 public:
-    Terrain();
-    ~Terrain();
+    static constexpr int kMaxOctaves = 8;
 
-    std::vector<float> generateTerrain();
-    std::vector<float> generateTile(int tileX, int tileY);
-    glm::vec3 getPosition(int row, int col);
-    glm::vec3 getNormal(int row, int col);
-    glm::vec3 getColor(glm::vec3 normal, glm::vec3 position);
+    Terrain(uint32_t seed = 1230, const NoiseParams& noise = NoiseParams());
+    ~Terrain();
 
     int getResolution() { return m_resolution; }
     int getTilesPerSide() { return m_tilesPerSide; }
     int getTileResolution() { return m_tileResolution; }
 
+    // Parameters of the height/slope color ramp evaluated in terrain.vert
+    glm::vec3 getSandColor() { return m_sandColor; }
+    float getColorHeightMin() { return m_colorHeightMin; }
+    float getColorHeightMax() { return m_colorHeightMax; }
+
     // New methods for terrain deformation
     void divot(float x, float y, float depth, float radius);
-    float getHeightModification(float x, float y);
 
     // Tile management
     void getTileCoordinates(float x, float y, int& tileX, int& tileY);
+    void getTileVertexRange(int tileX, int tileY, int& startRow, int& endRow, int& startCol, int& endCol);
+    TileBounds getTileBounds(int tileX, int tileY, const std::vector<float>& heights);
     std::vector<int> getAffectedTiles(float x, float y, float radius);
-    void updateTile(int tileX, int tileY, std::vector<float>& allVerts);
+    std::vector<int> getTilesInRect(float minX, float minY, float maxX, float maxY);
+
+    // Height-grid samples owned by a tile; like the vertex range, but the border
+    // tiles also own the apron. Deltas are copied row by row in that range.
+    void getTileGridRange(int tileX, int tileY, int& startRow, int& endRow, int& startCol, int& endCol);
+    void readTileDeltas(int tileIndex, std::vector<float>& deltas);
+    void writeTileDeltas(int tileIndex, const std::vector<float>& deltas);
+
+    // One relaxation pass over the grid samples of the tiles: wherever neighbouring
+    // heights differ by more than maxStep, rate * excess moves downhill. Sand only
+    // moves between samples of these tiles, so their total height is conserved.
+    // Tiles whose samples changed are added to movedTiles. Returns false if nothing moved.
+    bool relaxSand(const std::vector<int>& tiles, float maxStep, float rate, float minExcess,
+                   std::vector<int>& movedTiles);
 
     bool m_wireshade;
     float getHeight(float x, float y);
 
+    // Regenerates the base heights with new fBm settings; sculpted deltas are kept
+    void setNoiseParams(const NoiseParams& noise);
+    const NoiseParams& getNoiseParams() { return m_noise; }
+    uint32_t getSeed() { return m_seed; }
+
+    // Persistence: copies out / replaces both height layers (grid layout, apron included)
+    // without touching the noise, so a saved garden loads without regenerating
+    int getGridSide() { return m_resolution + 3; }
+    int getGridSampleCount() { return getGridSide() * getGridSide(); }
+    int getGridIndex(int row, int col) { return (row + 1) * (m_resolution + 3) + (col + 1); }
+    void readHeightLayers(std::vector<float>& baseHeights, std::vector<float>& heightDeltas);
+
+    // Copies the summed heights of grid samples [startRow, endRow) x [startCol, endCol)
+    // to the same positions of heights, a grid-layout array of getGridSampleCount() floats
+    void readHeights(int startRow, int endRow, int startCol, int endCol, std::vector<float>& heights);
+    void restoreHeightLayers(uint32_t seed, const NoiseParams& noise,
+                             const float* baseHeights, const float* heightDeltas);
+
 private:
 
     float computePerlin(float x, float y);
+    void computePerlinBatch(const float* xs, const float* ys, int count, float* out);
     glm::vec2 sampleRandomVector(int row, int col);
 
-    std::vector<glm::vec2> m_randVecLookup;
+    // fBm over one grid row; the octave count and variant are template parameters
+    // so the common configurations compile to fully unrolled loops
+    void computeFbmRow(float x, const float* ys, int count, float* out);
+    template <int Octaves, NoiseVariant Variant>
+    void computeFbmRowImpl(float x, const float* ys, int count, float* out);
+    template <int Octaves>
+    void dispatchFbmVariant(float x, const float* ys, int count, float* out);
+
+    // Cached heightfield over the vertex grid plus a one-sample apron for normals
+    void fillHeights();
+    void storeNoiseParams(const NoiseParams& noise);
+    float sampleGrid(const std::vector<float>& grid, float x, float y);
+
+    uint32_t m_seed;         // selects the gradient field of the noise
     int m_resolution;        // Total resolution (e.g., 100)
     int m_tilesPerSide;      // Number of tiles per side (e.g., 10)
     int m_tileResolution;    // Resolution per tile (e.g., 10)
-    int m_lookupSize;
 
-    // Store crater/divot information: (x, y, depth, radius)
-    std::vector<glm::vec4> m_displacements;
+    NoiseParams m_noise;
+    std::array<float, kMaxOctaves> m_octaveFrequency;  // derived from m_noise
+    std::array<float, kMaxOctaves> m_octaveAmplitude;
+
+    glm::vec3 m_sandColor;   // color of flat sand at the bottom of the height ramp
+    float m_colorHeightMin;  // heights mapped onto the color ramp
+    float m_colorHeightMax;
+
+    // Workers for generation; tiles and grid rows are independent
+    ThreadPool m_threadPool;
+
+    std::vector<float> m_baseHeights;   // noise only, filled once
+    std::vector<float> m_heightDeltas;  // accumulated divots, same layout as m_baseHeights
+
+    // Sculpting writes heights exclusively; height reads share it, so they can run
+    // on worker threads while the GUI thread keeps sculpting
+    std::shared_mutex m_heightMutex;
 };
 
 #endif // Terrain_H
@@ -0,0 +1,184 @@
+#include "terrainquadtree.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Where in a level's range the morph toward the next level starts
+static constexpr float kMorphStart = 0.75f;
+
+TerrainQuadtree::TerrainQuadtree()
+{
+}
+
+void TerrainQuadtree::build(Terrain& terrain, const std::vector<TileBounds>& tileBounds) {
+    m_resolution = terrain.getResolution();
+    m_tilesPerSide = terrain.getTilesPerSide();
+    m_tileResolution = terrain.getTileResolution();
+
+    // quadrants split a tile in half, so tiles need an even number of cells
+    m_patchResolution = std::max(1, m_tileResolution / 2);
+
+    m_treeTiles = 1;
+    m_levelCount = 1;
+    while (m_treeTiles < m_tilesPerSide) {
+        m_treeTiles *= 2;
+        m_levelCount++;
+    }
+
+    m_levels.assign(m_levelCount, {});
+    for (int level = 0; level < m_levelCount; level++) {
+        m_levels[level].assign(nodesPerSide(level) * nodesPerSide(level), {INFINITY, -INFINITY});
+    }
+    for (int tileIndex = 0; tileIndex < (int)tileBounds.size(); tileIndex++) {
+        node(0, tileIndex % m_tilesPerSide, tileIndex / m_tilesPerSide) = {tileBounds[tileIndex].minHeight,
+                                                                           tileBounds[tileIndex].maxHeight};
+    }
+    for (int level = 1; level < m_levelCount; level++) {
+        for (int ny = 0; ny < nodesPerSide(level); ny++) {
+            for (int nx = 0; nx < nodesPerSide(level); nx++) {
+                refreshNode(level, nx, ny);
+            }
+        }
+    }
+
+    setBaseRange(m_baseRange);
+}
+
+// Two triangles per patch cell, split along the same diagonal as the picking mesh.
+// Patch vertex (row, col) is gl_VertexID row * (patchResolution + 1) + col.
+std::vector<unsigned int> TerrainQuadtree::generatePatchIndices() {
+    std::vector<unsigned int> indices;
+    indices.reserve(m_patchResolution * m_patchResolution * 6);
+
+    int side = m_patchResolution + 1;
+    for (int x = 0; x < m_patchResolution; x++) {
+        for (int y = 0; y < m_patchResolution; y++) {
+            unsigned int i1 = x * side + y;
+            unsigned int i2 = (x + 1) * side + y;
+            unsigned int i3 = (x + 1) * side + y + 1;
+            unsigned int i4 = x * side + y + 1;
+
+            indices.push_back(i1);
+            indices.push_back(i2);
+            indices.push_back(i3);
+
+            indices.push_back(i1);
+            indices.push_back(i3);
+            indices.push_back(i4);
+        }
+    }
+    return indices;
+}
+
+void TerrainQuadtree::updateTile(int tileIndex, const TileBounds& bounds) {
+    int nx = tileIndex % m_tilesPerSide;
+    int ny = tileIndex / m_tilesPerSide;
+    node(0, nx, ny) = {bounds.minHeight, bounds.maxHeight};
+    for (int level = 1; level < m_levelCount; level++) {
+        nx /= 2;
+        ny /= 2;
+        refreshNode(level, nx, ny);
+    }
+}
+
+void TerrainQuadtree::setBaseRange(float baseRange) {
+    m_baseRange = baseRange;
+    if (m_levelCount == 0) return;  // applied by build()
+    m_ranges.resize(m_levelCount);
+    m_morphRanges.resize(m_levelCount);
+    for (int level = 0; level < m_levelCount; level++) {
+        m_ranges[level] = baseRange * (1 << level);
+        m_morphRanges[level] = glm::vec2(m_ranges[level] * kMorphStart, m_ranges[level]);
+    }
+    // the root has nothing coarser to morph into; finite, so the shader's division stays defined
+    m_morphRanges[m_levelCount - 1] = glm::vec2(1e30f, 2e30f);
+}
+
+void TerrainQuadtree::refreshNode(int level, int nx, int ny) {
+    NodeBounds bounds = {INFINITY, -INFINITY};
+    for (int child = 0; child < 4; child++) {
+        const NodeBounds& c = node(level - 1, nx * 2 + (child & 1), ny * 2 + (child >> 1));
+        bounds.minHeight = std::min(bounds.minHeight, c.minHeight);
+        bounds.maxHeight = std::max(bounds.maxHeight, c.maxHeight);
+    }
+    node(level, nx, ny) = bounds;
+}
+
+// Terrain-space box of a node, clipped to the edge of the terrain
+void TerrainQuadtree::nodeBox(int level, int nx, int ny, glm::vec3& boxMin, glm::vec3& boxMax) {
+    float nodeSize = (float)(m_tileResolution << level) / m_resolution;
+    const NodeBounds& bounds = node(level, nx, ny);
+    boxMin = glm::vec3(nx * nodeSize, ny * nodeSize, bounds.minHeight);
+    boxMax = glm::vec3(std::min(1.0f, (nx + 1) * nodeSize), std::min(1.0f, (ny + 1) * nodeSize), bounds.maxHeight);
+}
+
+static bool boxInSphere(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::vec3& center, float radius) {
+    glm::vec3 closest = glm::clamp(center, boxMin, boxMax);
+    glm::vec3 d = closest - center;
+    return glm::dot(d, d) <= radius * radius;
+}
+
+void TerrainQuadtree::select(const Frustum& frustum, const glm::vec3& cameraPosition, std::vector<glm::vec4>& patches) {
+    selectNode(m_levelCount - 1, 0, 0, frustum, cameraPosition, patches);
+}
+
+// Returns false when the node is beyond its level's range, so the parent has to
+// cover its area at the parent's level instead
+bool TerrainQuadtree::selectNode(int level, int nx, int ny, const Frustum& frustum,
+                                 const glm::vec3& cameraPosition, std::vector<glm::vec4>& patches) {
+    if (!nodeExists(level, nx, ny)) return true;
+
+    glm::vec3 boxMin, boxMax;
+    nodeBox(level, nx, ny, boxMin, boxMax);
+    if (!frustum.intersectsBox(boxMin, boxMax)) return true;
+
+    bool isRoot = level == m_levelCount - 1;
+    if (!isRoot && !boxInSphere(boxMin, boxMax, cameraPosition, m_ranges[level])) return false;
+
+    // entirely outside the finer level's range: this node's detail is enough everywhere
+    if (level == 0 || !boxInSphere(boxMin, boxMax, cameraPosition, m_ranges[level - 1])) {
+        for (int quadrant = 0; quadrant < 4; quadrant++) {
+            addQuadrant(level, nx, ny, quadrant, patches);
+        }
+        return true;
+    }
+
+    for (int quadrant = 0; quadrant < 4; quadrant++) {
+        if (!selectNode(level - 1, nx * 2 + (quadrant & 1), ny * 2 + (quadrant >> 1), frustum, cameraPosition, patches)) {
+            addQuadrant(level, nx, ny, quadrant, patches);
+        }
+    }
+    return true;
+}
+
+void TerrainQuadtree::addQuadrant(int level, int nx, int ny, int quadrant, std::vector<glm::vec4>& patches) {
+    int stride = 1 << level;
+    int originRow = (nx * m_tileResolution << level) + (quadrant & 1) * m_patchResolution * stride;
+    int originCol = (ny * m_tileResolution << level) + (quadrant >> 1) * m_patchResolution * stride;
+
+    // quadrants past the edge of the terrain have nothing to draw
+    if (originRow >= m_resolution || originCol >= m_resolution) return;
+
+    patches.push_back(glm::vec4(originRow, originCol, stride, level));
+}
+
+void TerrainQuadtree::selectTiles(const Frustum& frustum, std::vector<int>& tiles) {
+    selectTilesNode(m_levelCount - 1, 0, 0, frustum, tiles);
+}
+
+// Culls whole subtrees at once; only nodes that intersect the frustum are opened
+void TerrainQuadtree::selectTilesNode(int level, int nx, int ny, const Frustum& frustum, std::vector<int>& tiles) {
+    if (!nodeExists(level, nx, ny)) return;
+
+    glm::vec3 boxMin, boxMax;
+    nodeBox(level, nx, ny, boxMin, boxMax);
+    if (!frustum.intersectsBox(boxMin, boxMax)) return;
+
+    if (level == 0) {
+        tiles.push_back(ny * m_tilesPerSide + nx);
+        return;
+    }
+    for (int child = 0; child < 4; child++) {
+        selectTilesNode(level - 1, nx * 2 + (child & 1), ny * 2 + (child >> 1), frustum, tiles);
+    }
+}
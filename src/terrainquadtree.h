@@ -0,0 +1,73 @@
+#ifndef TERRAINQUADTREE_H
+#define TERRAINQUADTREE_H
+
+#include <vector>
+#include "glm/glm.hpp"
+#include "terrain.h"
+#include "utils/frustum.h"
+
+// Continuous distance-based LOD (CDLOD) over the terrain tiles.
+//
+// Level 0 nodes are the terrain's tiles; each level up doubles the node size and
+// the grid stride, so every node is drawn with the same number of triangles. The
+// tree is rounded up to a power-of-two number of tiles, and nodes past the edge of
+// the terrain are skipped. Nodes are drawn as four quadrant patches of
+// getPatchResolution()^2 cells, so a parent can fill in just the quadrants its
+// children don't cover. Vertices morph toward the next coarser grid as they near
+// the end of their level's range, so switching levels never pops.
+class TerrainQuadtree
+{
+public:
+    TerrainQuadtree();
+
+    // Sizes the tree for the terrain's tiling and takes every tile's height bounds
+    void build(Terrain& terrain, const std::vector<TileBounds>& tileBounds);
+    // Refreshes one tile's bounds and the bounds of the nodes above it
+    void updateTile(int tileIndex, const TileBounds& bounds);
+
+    // Distance (in terrain units) within which level 0 is used; level L reaches baseRange * 2^L
+    void setBaseRange(float baseRange);
+
+    int getPatchResolution() { return m_patchResolution; }
+    std::vector<unsigned int> generatePatchIndices();
+    // (start, end) of the morph toward level + 1 for every level, for terrain.vert
+    const std::vector<glm::vec2>& getMorphRanges() { return m_morphRanges; }
+
+    // Appends one (originRow, originCol, stride, level) record per quadrant patch to draw.
+    // frustum and cameraPosition are in terrain space.
+    void select(const Frustum& frustum, const glm::vec3& cameraPosition, std::vector<glm::vec4>& patches);
+    // Appends the index of every tile that intersects the frustum (terrain space)
+    void selectTiles(const Frustum& frustum, std::vector<int>& tiles);
+
+private:
+    struct NodeBounds {
+        float minHeight;
+        float maxHeight;
+    };
+
+    int nodesPerSide(int level) { return m_treeTiles >> level; }
+    NodeBounds& node(int level, int nx, int ny) { return m_levels[level][ny * nodesPerSide(level) + nx]; }
+    bool nodeExists(int level, int nx, int ny) { return (nx << level) < m_tilesPerSide && (ny << level) < m_tilesPerSide; }
+    void nodeBox(int level, int nx, int ny, glm::vec3& boxMin, glm::vec3& boxMax);
+    void refreshNode(int level, int nx, int ny);
+
+    bool selectNode(int level, int nx, int ny, const Frustum& frustum, const glm::vec3& cameraPosition,
+                    std::vector<glm::vec4>& patches);
+    void addQuadrant(int level, int nx, int ny, int quadrant, std::vector<glm::vec4>& patches);
+    void selectTilesNode(int level, int nx, int ny, const Frustum& frustum, std::vector<int>& tiles);
+
+    int m_resolution = 0;
+    int m_tilesPerSide = 0;
+    int m_tileResolution = 0;
+    int m_treeTiles = 0;        // tiles per side of the root, a power of two
+    int m_levelCount = 0;
+    int m_patchResolution = 0;  // cells per side of a quadrant patch
+
+    float m_baseRange = 1.0f;
+    std::vector<float> m_ranges;
+    std::vector<glm::vec2> m_morphRanges;
+
+    std::vector<std::vector<NodeBounds>> m_levels;  // m_levels[0] holds the tiles
+};
+
+#endif // TERRAINQUADTREE_H
@@ -0,0 +1,27 @@
+#include "frustum.h"
+
+void Frustum::setFromMatrix(const glm::mat4& clip) {
+    // rows of the matrix; glm stores columns
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+    }
+
+    m_planes[0] = rows[3] + rows[0];  // left
+    m_planes[1] = rows[3] - rows[0];  // right
+    m_planes[2] = rows[3] + rows[1];  // bottom
+    m_planes[3] = rows[3] - rows[1];  // top
+    m_planes[4] = rows[3] + rows[2];  // near
+    m_planes[5] = rows[3] - rows[2];  // far
+}
+
+bool Frustum::intersectsBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+    for (const glm::vec4& plane : m_planes) {
+        // the box corner furthest along the plane normal
+        glm::vec3 corner(plane.x >= 0 ? boxMax.x : boxMin.x,
+                         plane.y >= 0 ? boxMax.y : boxMin.y,
+                         plane.z >= 0 ? boxMax.z : boxMin.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0) return false;
+    }
+    return true;
+}
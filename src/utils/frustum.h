@@ -0,0 +1,21 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+// The six clip planes of a view frustum, for conservative box culling.
+class Frustum
+{
+public:
+    // Extracts the planes from a combined projection * view * model matrix; boxes
+    // tested afterwards are in that model's space
+    void setFromMatrix(const glm::mat4& clip);
+
+    // False only when the box lies entirely outside one of the planes
+    bool intersectsBox(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
+private:
+    glm::vec4 m_planes[6];  // (normal, distance), normals pointing inwards
+};
+
+#endif // FRUSTUM_H
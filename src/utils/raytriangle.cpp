@@ -0,0 +1,221 @@
+#include "raytriangle.h"
+
+#include <cstring>
+
+// Widest SIMD path the compiler targets; anything else runs the lanes one by one
+#if defined(__AVX2__)
+#define RAYTRIANGLE_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RAYTRIANGLE_SSE2
+#include <emmintrin.h>
+#endif
+
+static const float EPSILON = 0.0000001f;
+
+void TrianglePacket::clear() {
+    std::memset(this, 0, sizeof(TrianglePacket));
+}
+
+void TrianglePacket::set(int lane, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    glm::vec3 e1 = b - a;
+    glm::vec3 e2 = c - a;
+    for (int axis = 0; axis < 3; axis++) {
+        v0[axis][lane] = a[axis];
+        edge1[axis][lane] = e1[axis];
+        edge2[axis][lane] = e2[axis];
+    }
+}
+
+std::vector<TrianglePacket> packTriangles(const std::vector<float>& vertexData, int floatsPerVertex) {
+    int triangleFloats = 3 * floatsPerVertex;
+    int triangleCount = vertexData.size() / triangleFloats;
+
+    std::vector<TrianglePacket> packets((triangleCount + kTrianglePacketWidth - 1) / kTrianglePacketWidth);
+    for (TrianglePacket& packet : packets) packet.clear();
+
+    for (int i = 0; i < triangleCount; i++) {
+        const float* p = &vertexData[i * triangleFloats];
+        packets[i / kTrianglePacketWidth].set(i % kTrianglePacketWidth,
+                                              glm::vec3(p[0], p[1], p[2]),
+                                              glm::vec3(p[floatsPerVertex], p[floatsPerVertex + 1], p[floatsPerVertex + 2]),
+                                              glm::vec3(p[2 * floatsPerVertex], p[2 * floatsPerVertex + 1], p[2 * floatsPerVertex + 2]));
+    }
+    return packets;
+}
+
+// Picks the nearest of the lanes set in mask; lowers t if it is nearer
+static inline int nearestLane(int mask, const float* ts, int count, int firstLane, float& t, int lane) {
+    for (int i = 0; i < count; i++) {
+        if ((mask >> i) & 1 && ts[i] < t) {
+            t = ts[i];
+            lane = firstLane + i;
+        }
+    }
+    return lane;
+}
+
+#if defined(RAYTRIANGLE_AVX2)
+int rayIntersectsPacket(const glm::vec3& rayOrigin, const glm::vec3& rayDirection,
+                        const TrianglePacket& packet, float& t) {
+    __m256 dx = _mm256_set1_ps(rayDirection.x);
+    __m256 dy = _mm256_set1_ps(rayDirection.y);
+    __m256 dz = _mm256_set1_ps(rayDirection.z);
+    __m256 e1x = _mm256_load_ps(packet.edge1[0]);
+    __m256 e1y = _mm256_load_ps(packet.edge1[1]);
+    __m256 e1z = _mm256_load_ps(packet.edge1[2]);
+    __m256 e2x = _mm256_load_ps(packet.edge2[0]);
+    __m256 e2y = _mm256_load_ps(packet.edge2[1]);
+    __m256 e2z = _mm256_load_ps(packet.edge2[2]);
+
+    // h = dir x edge2, a = edge1 . h
+    __m256 hx = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+    __m256 hy = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+    __m256 hz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+    __m256 a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, hx), _mm256_mul_ps(e1y, hy)), _mm256_mul_ps(e1z, hz));
+    __m256 signA = _mm256_and_ps(a, _mm256_set1_ps(-0.0f));
+    __m256 absA = _mm256_xor_ps(a, signA);
+
+    // s = origin - v0; u, v and t scaled by |a| (see the SSE2 version)
+    __m256 sx = _mm256_sub_ps(_mm256_set1_ps(rayOrigin.x), _mm256_load_ps(packet.v0[0]));
+    __m256 sy = _mm256_sub_ps(_mm256_set1_ps(rayOrigin.y), _mm256_load_ps(packet.v0[1]));
+    __m256 sz = _mm256_sub_ps(_mm256_set1_ps(rayOrigin.z), _mm256_load_ps(packet.v0[2]));
+    __m256 u = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, hx), _mm256_mul_ps(sy, hy)), _mm256_mul_ps(sz, hz));
+    u = _mm256_xor_ps(u, signA);
+
+    // q = s x edge1
+    __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+    __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+    __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+    __m256 v = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz));
+    v = _mm256_xor_ps(v, signA);
+    __m256 tt = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz));
+    tt = _mm256_xor_ps(tt, signA);
+
+    __m256 zero = _mm256_setzero_ps();
+    __m256 eps = _mm256_set1_ps(EPSILON);
+    __m256 mask = _mm256_cmp_ps(absA, eps, _CMP_GE_OQ);
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(u, absA, _CMP_LE_OQ));
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(_mm256_add_ps(u, v), absA, _CMP_LE_OQ));
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(tt, _mm256_mul_ps(eps, absA), _CMP_GT_OQ));
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(tt, _mm256_mul_ps(_mm256_set1_ps(t), absA), _CMP_LT_OQ));
+
+    int bits = _mm256_movemask_ps(mask);
+    if (!bits) return -1;
+    alignas(32) float ts[8];
+    _mm256_store_ps(ts, _mm256_div_ps(tt, absA));
+    return nearestLane(bits, ts, 8, 0, t, -1);
+}
+#elif defined(RAYTRIANGLE_SSE2)
+// The ray broadcast to every lane
+struct Ray4 {
+    __m128 ox, oy, oz;
+    __m128 dx, dy, dz;
+};
+
+static inline Ray4 broadcastRay(const glm::vec3& rayOrigin, const glm::vec3& rayDirection) {
+    return {_mm_set1_ps(rayOrigin.x), _mm_set1_ps(rayOrigin.y), _mm_set1_ps(rayOrigin.z),
+            _mm_set1_ps(rayDirection.x), _mm_set1_ps(rayDirection.y), _mm_set1_ps(rayDirection.z)};
+}
+
+// Lanes [firstLane, firstLane + 4) of the packet
+static inline int intersect4(const Ray4& ray, const TrianglePacket& packet, int firstLane, float& t, int lane) {
+    __m128 dx = ray.dx;
+    __m128 dy = ray.dy;
+    __m128 dz = ray.dz;
+    __m128 e1x = _mm_load_ps(packet.edge1[0] + firstLane);
+    __m128 e1y = _mm_load_ps(packet.edge1[1] + firstLane);
+    __m128 e1z = _mm_load_ps(packet.edge1[2] + firstLane);
+    __m128 e2x = _mm_load_ps(packet.edge2[0] + firstLane);
+    __m128 e2y = _mm_load_ps(packet.edge2[1] + firstLane);
+    __m128 e2z = _mm_load_ps(packet.edge2[2] + firstLane);
+
+    // h = dir x edge2, a = edge1 . h
+    __m128 hx = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+    __m128 hy = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+    __m128 hz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+    __m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, hx), _mm_mul_ps(e1y, hy)), _mm_mul_ps(e1z, hz));
+    __m128 signA = _mm_and_ps(a, _mm_set1_ps(-0.0f));
+    __m128 absA = _mm_xor_ps(a, signA);
+
+    // s = origin - v0. u, v and t are left multiplied by |a|, with a's sign folded
+    // in, and the bounds are scaled to match; only hits pay for the divide.
+    __m128 sx = _mm_sub_ps(ray.ox, _mm_load_ps(packet.v0[0] + firstLane));
+    __m128 sy = _mm_sub_ps(ray.oy, _mm_load_ps(packet.v0[1] + firstLane));
+    __m128 sz = _mm_sub_ps(ray.oz, _mm_load_ps(packet.v0[2] + firstLane));
+    __m128 u = _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, hx), _mm_mul_ps(sy, hy)), _mm_mul_ps(sz, hz));
+    u = _mm_xor_ps(u, signA);
+
+    // q = s x edge1
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+    __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz));
+    v = _mm_xor_ps(v, signA);
+    __m128 tt = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz));
+    tt = _mm_xor_ps(tt, signA);
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 eps = _mm_set1_ps(EPSILON);
+    __m128 mask = _mm_cmpge_ps(absA, eps);
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(u, absA));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), absA));
+    mask = _mm_and_ps(mask, _mm_cmpgt_ps(tt, _mm_mul_ps(eps, absA)));
+    mask = _mm_and_ps(mask, _mm_cmplt_ps(tt, _mm_mul_ps(_mm_set1_ps(t), absA)));
+
+    int bits = _mm_movemask_ps(mask);
+    if (!bits) return lane;
+    alignas(16) float ts[4];
+    _mm_store_ps(ts, _mm_div_ps(tt, absA));
+    return nearestLane(bits, ts, 4, firstLane, t, lane);
+}
+
+int rayIntersectsPacket(const glm::vec3& rayOrigin, const glm::vec3& rayDirection,
+                        const TrianglePacket& packet, float& t) {
+    Ray4 ray = broadcastRay(rayOrigin, rayDirection);
+    int lane = intersect4(ray, packet, 0, t, -1);
+    return intersect4(ray, packet, 4, t, lane);
+}
+#else
+int rayIntersectsPacket(const glm::vec3& rayOrigin, const glm::vec3& rayDirection,
+                        const TrianglePacket& packet, float& t) {
+    int lane = -1;
+    for (int i = 0; i < kTrianglePacketWidth; i++) {
+        glm::vec3 edge1(packet.edge1[0][i], packet.edge1[1][i], packet.edge1[2][i]);
+        glm::vec3 edge2(packet.edge2[0][i], packet.edge2[1][i], packet.edge2[2][i]);
+        glm::vec3 h = glm::cross(rayDirection, edge2);
+        float a = glm::dot(edge1, h);
+        if (a > -EPSILON && a < EPSILON) continue;
+
+        float f = 1.0f / a;
+        glm::vec3 s = rayOrigin - glm::vec3(packet.v0[0][i], packet.v0[1][i], packet.v0[2][i]);
+        float u = f * glm::dot(s, h);
+        if (u < 0.0f || u > 1.0f) continue;
+
+        glm::vec3 q = glm::cross(s, edge1);
+        float v = f * glm::dot(rayDirection, q);
+        if (v < 0.0f || u + v > 1.0f) continue;
+
+        float tHit = f * glm::dot(edge2, q);
+        if (tHit > EPSILON && tHit < t) {
+            t = tHit;
+            lane = i;
+        }
+    }
+    return lane;
+}
+#endif
+
+int rayIntersectsPackets(const glm::vec3& rayOrigin, const glm::vec3& rayDirection,
+                         const std::vector<TrianglePacket>& packets, float& t) {
+    int hit = -1;
+    for (size_t i = 0; i < packets.size(); i++) {
+        int lane = rayIntersectsPacket(rayOrigin, rayDirection, packets[i], t);
+        if (lane != -1) hit = i * kTrianglePacketWidth + lane;
+    }
+    return hit;
+}
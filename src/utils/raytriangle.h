@@ -0,0 +1,34 @@
+#ifndef RAYTRIANGLE_H
+#define RAYTRIANGLE_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Triangles stored structure-of-arrays, kTrianglePacketWidth to a packet, so one
+// ray is tested against a whole packet at once. Each triangle is kept as its first
+// corner and the two edges leaving it, which is what Möller Trumbore works with.
+// Unused lanes have zero edges and never report a hit.
+constexpr int kTrianglePacketWidth = 8;
+
+struct alignas(32) TrianglePacket {
+    float v0[3][kTrianglePacketWidth];
+    float edge1[3][kTrianglePacketWidth];
+    float edge2[3][kTrianglePacketWidth];
+
+    void clear();
+    void set(int lane, const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2);
+};
+
+// Packs interleaved vertex data (position first, three vertices per triangle)
+std::vector<TrianglePacket> packTriangles(const std::vector<float>& vertexData, int floatsPerVertex);
+
+// Möller Trumbore against every lane. Keeps the nearest hit with t in (0, t), where
+// t is measured along dir, which need not be normalized. Lowers t and returns the
+// lane on a hit, -1 otherwise.
+int rayIntersectsPacket(const glm::vec3& rayOrigin, const glm::vec3& rayDirection,
+                        const TrianglePacket& packet, float& t);
+// The same over many packets; returns packet * kTrianglePacketWidth + lane, or -1
+int rayIntersectsPackets(const glm::vec3& rayOrigin, const glm::vec3& rayDirection,
+                         const std::vector<TrianglePacket>& packets, float& t);
+
+#endif // RAYTRIANGLE_H
@@ -46,7 +46,25 @@ public:
         return programID;
     }
 
+    // Source of the shader at filepath with the snippet file spliced in right after its
+    // #version line, so stages can share helpers (GLSL has no #include)
+    static QByteArray readShaderSource(const char *filepath, const char *snippetPath){
+        QByteArray code = readFile(filepath);
+        int version = code.indexOf("#version");
+        int insertAt = version == -1 ? 0 : code.indexOf('\n', version) + 1;
+        code.insert(insertAt, readFile(snippetPath));
+        return code;
+    }
+
 private:
+    static QByteArray readFile(const char *filepath){
+        QFile file(filepath);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            throw std::runtime_error(std::string("Failed to open shader: ")+filepath);
+        }
+        return file.readAll();
+    }
+
     static GLuint createShader(GLenum shaderType, const char *filepath){
         GLuint shaderID = glCreateShader(shaderType);
 
@@ -0,0 +1,40 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that run queued jobs in FIFO order.
+class ThreadPool {
+public:
+    // numThreads <= 0 uses one worker per hardware thread
+    explicit ThreadPool(int numThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Queues a job to run on some worker; returns immediately
+    void submit(std::function<void()> job);
+
+    // Runs body(i) for every i in [0, count) across the workers and the calling
+    // thread, returning once all iterations have finished
+    void parallelFor(int count, const std::function<void(int)>& body);
+
+    int getThreadCount() const { return m_workers.size(); }
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_jobAvailable;
+    bool m_stopping = false;
+};
+
+#endif // THREADPOOL_H